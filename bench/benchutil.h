@@ -0,0 +1,20 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+
+namespace Rain {
+// the fastest of runs calls of f in milliseconds
+template <typename F>
+double BestMs(int runs, F&& f) {
+  double best = 1e30;
+  for (int i = 0; i < runs; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double, std::milli> t =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, t.count());
+  }
+  return best;
+}
+};  // namespace Rain
\ No newline at end of file
@@ -0,0 +1,71 @@
+// Frustum culls random boxes with the SIMD pass and with the one box at a
+// time reference, from a camera in the middle of the field.
+//   xmake build cull_bench && cd bin && ./cull_bench [objects] [runs]
+#include <spdlog/spdlog.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "benchutil.h"
+#include "scene/culling.h"
+
+using namespace Rain;
+
+namespace {
+// same projection as Camera::UpdateData
+Mat4f Perspective(float fovy, float aspect, float z_near, float z_far) {
+  float y_scale = 1.0f / std::tan(fovy / 2);
+  Mat4f proj;
+  proj << y_scale / aspect, 0, 0, 0, 0, y_scale, 0, 0, 0, 0,
+      -z_far / (z_far - z_near), -z_near * z_far / (z_far - z_near), 0, 0, -1,
+      0;
+  return proj;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  spdlog::set_pattern("[%^%l%$] %v");
+  size_t n_object = argc > 1 ? std::atoll(argv[1]) : 100000;
+  int runs = argc > 2 ? std::atoi(argv[2]) : 20;
+
+  // objects of a few units spread over a field around the camera
+  float field = 10.0f * std::cbrt(float(n_object));
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> position(-field, field);
+  std::uniform_real_distribution<float> size(0.5f, 3.0f);
+  BoundsTable bounds;
+  bounds.Resize(n_object);
+  for (size_t i = 0; i < n_object; ++i) {
+    Vec3f center(position(rng), position(rng), position(rng));
+    Vec3f extent(size(rng), size(rng), size(rng));
+    bounds.Set(i, center - extent, center + extent);
+  }
+  Mat4f view = Mat4f::Identity();
+  view.block<3, 3>(0, 0) =
+      Eigen::AngleAxisf(0.6f, Vec3f(0.2f, 1.0f, 0.1f).normalized())
+          .toRotationMatrix();
+  Mat4f proj_view =
+      Perspective(0.25f * 3.14159265f, 16.0f / 9.0f, 1.0f, field) * view;
+  Vec4f planes[6];
+  Culling::ExtractPlanes(proj_view, planes);
+
+  std::vector<uint32_t> ref, visible;
+  double scalar_ms =
+      BestMs(runs, [&] { Culling::CullScalar(bounds, planes, ref); });
+  double simd_ms = BestMs(runs, [&] { Culling::Cull(bounds, planes, visible); });
+  if (visible != ref) {
+    spdlog::error("{} visible with SIMD, {} with the reference",
+                  visible.size(), ref.size());
+    return 1;
+  }
+  spdlog::info("{} objects tested, {} culled", n_object,
+               n_object - visible.size());
+  spdlog::info("scalar: {:.3f} ms, {:.2f} ns/object", scalar_ms,
+               scalar_ms * 1e6 / n_object);
+  spdlog::info("{}-wide: {:.3f} ms, {:.2f} ns/object, {:.1f}x",
+               Culling::LANES, simd_ms, simd_ms * 1e6 / n_object,
+               scalar_ms / simd_ms);
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,483 @@
+// Culls a fixed set of boxes with GpuCuller and compares the visible counts
+// of the draw ranges, the draw slots, the commands and the frustum counter
+// with Culling::Cull, then checks the occlusion counter against a known
+// occluder written into the depth buffer. Runs headless on the first
+// physical device with a graphics and compute queue, a software driver such
+// as lavapipe or SwiftShader will do.
+//   xmake build gpu_cull_check && cd bin && ./gpu_cull_check
+#include <spdlog/spdlog.h>
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "buffer/uniformring.h"
+#include "culling/gpuculler.h"
+#include "device/device.h"
+#include "image/image.h"
+#include "renderscene/renderscene.h"
+#include "scene/culling.h"
+
+using namespace Rain;
+
+namespace {
+const uint32_t WIDTH = 320;
+const uint32_t HEIGHT = 240;
+const float Z_NEAR = 1.0f;
+const float Z_FAR = 100.0f;
+// the occluder is a rectangle of the depth buffer at this distance, the
+// hidden boxes are far behind its middle
+const float OCCLUDER_DISTANCE = 10.0f;
+const float HIDDEN_DISTANCE = 40.0f;
+const uint32_t N_FIELD = 1000;
+const uint32_t N_HIDDEN = 16;
+const uint32_t N_BESIDE = 8;
+// draw ranges of the meshes, the instances are split evenly between them
+const uint32_t MESH_RANGES[] = {1, 2, 1};
+const uint32_t N_MESH = sizeof(MESH_RANGES) / sizeof(MESH_RANGES[0]);
+
+// same projection as Camera::UpdateData
+Mat4f Perspective(float fovy, float aspect, float z_near, float z_far) {
+  float y_scale = 1.0f / std::tan(fovy / 2);
+  Mat4f proj;
+  proj << y_scale / aspect, 0, 0, 0, 0, y_scale, 0, 0, 0, 0,
+      -z_far / (z_far - z_near), -z_near * z_far / (z_far - z_near), 0, 0, -1,
+      0;
+  return proj;
+}
+
+bool CreateDevice(VkInstance& instance, Device& device) {
+  VkApplicationInfo app_info{};
+  app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+  app_info.pApplicationName = "gpu_cull_check";
+  app_info.apiVersion = VK_API_VERSION_1_0;
+  VkInstanceCreateInfo instance_info{};
+  instance_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+  instance_info.pApplicationInfo = &app_info;
+  if (vkCreateInstance(&instance_info, nullptr, &instance) != VK_SUCCESS) {
+    return false;
+  }
+  uint32_t n_physical = 0;
+  vkEnumeratePhysicalDevices(instance, &n_physical, nullptr);
+  std::vector<VkPhysicalDevice> physicals(n_physical);
+  vkEnumeratePhysicalDevices(instance, &n_physical, physicals.data());
+  for (VkPhysicalDevice physical : physicals) {
+    uint32_t n_family = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical, &n_family, nullptr);
+    std::vector<VkQueueFamilyProperties> families(n_family);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical, &n_family,
+                                             families.data());
+    uint32_t graphics = UINT32_MAX;
+    for (uint32_t i = 0; i < n_family && graphics == UINT32_MAX; ++i) {
+      VkQueueFlags flags = families[i].queueFlags;
+      if ((flags & VK_QUEUE_GRAPHICS_BIT) && (flags & VK_QUEUE_COMPUTE_BIT)) {
+        graphics = i;
+      }
+    }
+    if (graphics == UINT32_MAX) continue;
+    // the compacted commands when the driver can draw them
+    uint32_t n_extension = 0;
+    vkEnumerateDeviceExtensionProperties(physical, nullptr, &n_extension,
+                                         nullptr);
+    std::vector<VkExtensionProperties> properties(n_extension);
+    vkEnumerateDeviceExtensionProperties(physical, nullptr, &n_extension,
+                                         properties.data());
+    std::vector<const char*> extensions;
+    for (const auto& property : properties) {
+      if (strcmp(property.extensionName,
+                 VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0) {
+        extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+      }
+    }
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(physical, &props);
+    spdlog::info("device: {}", props.deviceName);
+    return device.Init(physical, graphics, graphics, graphics, nullptr,
+                       &extensions) == VK_SUCCESS;
+  }
+  return false;
+}
+
+// a depth only pass clearing to the far plane, the occluder is cleared into
+// it afterwards
+VkResult CreateDepthPass(Device* device, Image& depth,
+                         VkRenderPass& render_pass,
+                         VkFramebuffer& framebuffer) {
+  VkAttachmentDescription attachment{};
+  attachment.format = depth.format_;
+  attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  // what GpuCuller::RecordPyramid expects, as after the scene pass
+  attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  VkAttachmentReference reference{};
+  reference.attachment = 0;
+  reference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  VkSubpassDescription subpass{};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.pDepthStencilAttachment = &reference;
+  VkRenderPassCreateInfo pass_info{};
+  pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  pass_info.attachmentCount = 1;
+  pass_info.pAttachments = &attachment;
+  pass_info.subpassCount = 1;
+  pass_info.pSubpasses = &subpass;
+  VkResult result = vkCreateRenderPass(device->device_, &pass_info, nullptr,
+                                       &render_pass);
+  if (result != VK_SUCCESS) return result;
+  VkFramebufferCreateInfo framebuffer_info{};
+  framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+  framebuffer_info.renderPass = render_pass;
+  framebuffer_info.attachmentCount = 1;
+  framebuffer_info.pAttachments = &depth.view_;
+  framebuffer_info.width = depth.width_;
+  framebuffer_info.height = depth.height_;
+  framebuffer_info.layers = 1;
+  return vkCreateFramebuffer(device->device_, &framebuffer_info, nullptr,
+                             &framebuffer);
+}
+
+// a box of half size extent at center, translation only
+void AddBox(const Vec3f& center, float extent,
+            std::vector<InstanceData>& instances, BoundsTable& bounds) {
+  InstanceData instance;
+  instance.model_.block<3, 1>(0, 3) = center;
+  instance.bbox_min_ = Vec4f(-extent, -extent, -extent, 0.0f);
+  instance.bbox_extent_ = Vec4f(2 * extent, 2 * extent, 2 * extent, 0.0f);
+  bounds.Set(instances.size(), center - Vec3f::Constant(extent),
+             center + Vec3f::Constant(extent));
+  instances.push_back(instance);
+}
+
+// the GPU results of a frame region against the visible instances expected
+bool Compare(const char* name, const std::vector<uint8_t>& region,
+             VkDeviceSize state_offset, VkDeviceSize slot_offset,
+             VkDeviceSize command_offset, bool compact,
+             const std::vector<InstanceData>& instances,
+             const std::vector<RangeData>& ranges,
+             const std::vector<DrawTemplate>& templates,
+             const std::vector<uint32_t>& template_counts,
+             const std::vector<bool>& visible, uint32_t n_frustum,
+             uint32_t n_occluded) {
+  bool ok = true;
+  CullState state;
+  memcpy(&state, region.data() + state_offset, sizeof(CullState));
+  const RangeData* gpu_ranges = reinterpret_cast<const RangeData*>(
+      region.data() + state_offset + sizeof(CullState));
+  const uint32_t* slots =
+      reinterpret_cast<const uint32_t*>(region.data() + slot_offset);
+  const VkDrawIndexedIndirectCommand* commands =
+      reinterpret_cast<const VkDrawIndexedIndirectCommand*>(
+          region.data() + command_offset);
+  spdlog::info("{}: {} tested, {} culled by the frustum, {} occluded", name,
+               state.n_tested_, state.n_frustum_, state.n_occluded_);
+  if (state.n_frustum_ != n_frustum || state.n_occluded_ != n_occluded) {
+    spdlog::error("{}: expected {} culled by the frustum, {} occluded", name,
+                  n_frustum, n_occluded);
+    ok = false;
+  }
+  // the material slots of the visible instances of each range
+  std::vector<std::vector<uint32_t>> expected(ranges.size());
+  for (const auto& instance : instances) {
+    size_t i = &instance - instances.data();
+    if (!visible[i]) continue;
+    for (uint32_t r = 0; r < instance.n_range_; ++r) {
+      expected[instance.first_range_ + r].push_back(instance.first_material_ +
+                                                    r * instance.stride_);
+    }
+  }
+  for (size_t r = 0; r < ranges.size(); ++r) {
+    uint32_t count = gpu_ranges[r].count_;
+    std::vector<uint32_t> written(slots + ranges[r].first_slot_,
+                                  slots + ranges[r].first_slot_ +
+                                      std::min<size_t>(count,
+                                                       expected[r].size()));
+    std::sort(written.begin(), written.end());
+    std::sort(expected[r].begin(), expected[r].end());
+    if (count != expected[r].size() || written != expected[r]) {
+      spdlog::error("{}: range {} has {} visible instances, expected {}", name,
+                    r, count, expected[r].size());
+      ok = false;
+    }
+  }
+  // one command per template, with no instance when culled, or the drawn
+  // ones packed in front of the count of their batch
+  std::vector<uint32_t> batch_counts(MAX_DRAW_BATCH, 0);
+  std::vector<std::vector<uint32_t>> batch_firsts(MAX_DRAW_BATCH);
+  for (size_t t = 0; t < templates.size(); ++t) {
+    const DrawTemplate& draw = templates[t];
+    uint32_t count = uint32_t(expected[draw.range_].size());
+    if (!compact) {
+      const VkDrawIndexedIndirectCommand& command = commands[t];
+      if (command.instanceCount != count ||
+          command.firstInstance != ranges[draw.range_].first_slot_ ||
+          command.indexCount != draw.index_count_) {
+        spdlog::error("{}: command {} draws {} instances, expected {}", name,
+                      t, command.instanceCount, count);
+        ok = false;
+      }
+    } else if (count) {
+      ++batch_counts[draw.batch_];
+      batch_firsts[draw.batch_].push_back(ranges[draw.range_].first_slot_);
+    }
+  }
+  for (uint32_t b = 0; compact && b < MAX_DRAW_BATCH; ++b) {
+    std::vector<uint32_t> firsts;
+    for (uint32_t k = 0; k < state.draw_counts_[b]; ++k) {
+      firsts.push_back(commands[template_counts[b] + k].firstInstance);
+    }
+    std::sort(firsts.begin(), firsts.end());
+    std::sort(batch_firsts[b].begin(), batch_firsts[b].end());
+    if (state.draw_counts_[b] != batch_counts[b] || firsts != batch_firsts[b]) {
+      spdlog::error("{}: batch {} has {} commands, expected {}", name, b,
+                    state.draw_counts_[b], batch_counts[b]);
+      ok = false;
+    }
+  }
+  return ok;
+}
+}  // namespace
+
+int main() {
+  spdlog::set_pattern("[%^%l%$] %v");
+  VkInstance instance = VK_NULL_HANDLE;
+  Device* device = new Device;
+  if (!CreateDevice(instance, *device)) {
+    spdlog::error("no vulkan device with a graphics and compute queue");
+    return 1;
+  }
+  // frame 0 culls against the frustum only, frame 1 against the pyramid too
+  GpuCuller culler;
+  if (culler.Init(device, 2) != VK_SUCCESS || !culler.supported_) {
+    spdlog::error("GPU culling unsupported, are the shaders compiled?");
+    return 1;
+  }
+  Image depth;
+  if (depth.InitDepthImage(device, WIDTH, HEIGHT) != VK_SUCCESS) return 1;
+  if (!(depth.usages_ & VK_IMAGE_USAGE_SAMPLED_BIT)) {
+    spdlog::error("depth format {} cannot be sampled", int(depth.format_));
+    return 1;
+  }
+  VkRenderPass render_pass = VK_NULL_HANDLE;
+  VkFramebuffer framebuffer = VK_NULL_HANDLE;
+  if (CreateDepthPass(device, depth, render_pass, framebuffer) != VK_SUCCESS) {
+    spdlog::error("depth pass creation failed");
+    return 1;
+  }
+  if (culler.InitPyramid(device, {&depth}) != VK_SUCCESS) return 1;
+
+  // camera at the origin looking down -z
+  Mat4f proj_view = Perspective(3.14159265f / 3, float(WIDTH) / HEIGHT,
+                                Z_NEAR, Z_FAR);
+  Vec4f planes[6];
+  Culling::ExtractPlanes(proj_view, planes);
+
+  // a field of boxes in front of the occluder, partly outside of the
+  // frustum, boxes hidden behind the middle of the occluder and boxes as far
+  // but beside it
+  std::vector<InstanceData> instances;
+  BoundsTable bounds;
+  bounds.Resize(N_FIELD + N_HIDDEN + N_BESIDE);
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> lateral(-10.0f, 10.0f);
+  std::uniform_real_distribution<float> depth_range(-OCCLUDER_DISTANCE + 1.0f,
+                                                    1.0f);
+  std::uniform_real_distribution<float> size(0.1f, 1.0f);
+  for (uint32_t i = 0; i < N_FIELD; ++i) {
+    AddBox(Vec3f(lateral(rng), lateral(rng), depth_range(rng)), size(rng),
+           instances, bounds);
+  }
+  std::vector<bool> hidden(N_FIELD, false);
+  for (uint32_t i = 0; i < N_HIDDEN; ++i) {
+    Vec3f center(-3.0f + 2.0f * (i % 4), -3.0f + 2.0f * (i / 4),
+                 -HIDDEN_DISTANCE);
+    AddBox(center, 0.5f, instances, bounds);
+    hidden.push_back(true);
+  }
+  for (uint32_t i = 0; i < N_BESIDE; ++i) {
+    Vec3f center(i % 2 ? 22.0f : -22.0f, -6.0f + 2.0f * (i / 2),
+                 -HIDDEN_DISTANCE);
+    AddBox(center, 0.5f, instances, bounds);
+    hidden.push_back(false);
+  }
+  uint32_t n_instance = uint32_t(instances.size());
+
+  // the instances of a mesh take adjacent slots, each of its draw ranges
+  // has one material slot per instance and one template, the batches
+  // alternate between meshes
+  std::vector<RangeData> ranges;
+  std::vector<DrawTemplate> templates;
+  std::vector<uint32_t> template_counts(MAX_DRAW_BATCH, 0);
+  uint32_t n_material = 0;
+  for (uint32_t m = 0; m < N_MESH; ++m) {
+    uint32_t first = n_instance * m / N_MESH;
+    uint32_t last = n_instance * (m + 1) / N_MESH;
+    for (uint32_t i = first; i < last; ++i) {
+      instances[i].first_range_ = uint32_t(ranges.size());
+      instances[i].n_range_ = MESH_RANGES[m];
+      instances[i].first_material_ = n_material + (i - first);
+      instances[i].stride_ = last - first;
+    }
+    for (uint32_t r = 0; r < MESH_RANGES[m]; ++r) {
+      RangeData range{};
+      range.first_slot_ = n_material;
+      n_material += last - first;
+      DrawTemplate draw{};
+      draw.index_count_ = 36 * (m + 1);
+      draw.range_ = uint32_t(ranges.size());
+      draw.batch_ = m % 2;
+      templates.push_back(draw);
+      ranges.push_back(range);
+    }
+  }
+  // the templates of a batch are adjacent, so are their commands
+  std::stable_sort(templates.begin(), templates.end(),
+                   [](const DrawTemplate& a, const DrawTemplate& b) {
+                     return a.batch_ < b.batch_;
+                   });
+  for (const auto& draw : templates) ++template_counts[draw.batch_];
+  for (uint32_t b = 0, first = 0; b < MAX_DRAW_BATCH; ++b) {
+    uint32_t count = template_counts[b];
+    template_counts[b] = first;
+    first += count;
+  }
+  for (auto& draw : templates) {
+    draw.first_command_ = template_counts[draw.batch_];
+  }
+  uint32_t n_template = uint32_t(templates.size());
+
+  // the areas of a frame region, as in RenderScene::InitModelUniform
+  auto align = [device](VkDeviceSize size) {
+    return VkDeviceSize(device->GetAlignedUniformByteOffset(
+        device->GetAlignedStorageByteOffset(uint32_t(size))));
+  };
+  VkDeviceSize areas[GpuCuller::BINDING_PYRAMID][2] = {
+      {0, sizeof(CullUniformData)},
+      {0, n_instance * sizeof(InstanceData)},
+      {0, sizeof(CullState) + ranges.size() * sizeof(RangeData)},
+      {0, n_template * sizeof(DrawTemplate)},
+      {0, n_material * sizeof(uint32_t)},
+      {0, n_template * sizeof(VkDrawIndexedIndirectCommand)},
+  };
+  VkDeviceSize frame_size = 0;
+  for (auto& area : areas) {
+    area[0] = frame_size;
+    frame_size += align(area[1]);
+  }
+  UniformRing ring;
+  if (ring.Init(device, 2, frame_size) != VK_SUCCESS) return 1;
+  for (uint32_t frame = 0; frame < 2; ++frame) {
+    VkDescriptorBufferInfo buffers[GpuCuller::BINDING_PYRAMID];
+    for (uint32_t i = 0; i < GpuCuller::BINDING_PYRAMID; ++i) {
+      buffers[i].buffer = ring.buffer_.buffer_;
+      buffers[i].offset = ring.GetOffset(frame, areas[i][0]);
+      buffers[i].range = areas[i][1];
+    }
+    culler.UpdateDescriptor(device->device_, frame, buffers);
+
+    CullUniformData cull_data{};
+    for (int p = 0; p < 6; ++p) cull_data.planes_[p] = planes[p];
+    cull_data.pyramid_proj_view_ = proj_view;
+    cull_data.pyramid_size_ =
+        Vec4f(float(WIDTH), float(HEIGHT), float(culler.pyramid_.mip_levels_),
+              frame == 1 ? 1.0f : 0.0f);
+    cull_data.n_instance_ = n_instance;
+    cull_data.n_template_ = n_template;
+    cull_data.frustum_ = 1;
+    CullState state{};
+    state.n_tested_ = n_instance;
+    ring.Write(frame, areas[GpuCuller::BINDING_CULL_DATA][0], &cull_data,
+               sizeof(cull_data));
+    ring.Write(frame, areas[GpuCuller::BINDING_INSTANCES][0],
+               instances.data(), n_instance * sizeof(InstanceData));
+    ring.Write(frame, areas[GpuCuller::BINDING_STATE][0], &state,
+               sizeof(state));
+    ring.Write(frame, areas[GpuCuller::BINDING_STATE][0] + sizeof(state),
+               ranges.data(), ranges.size() * sizeof(RangeData));
+    ring.Write(frame, areas[GpuCuller::BINDING_TEMPLATES][0],
+               templates.data(), n_template * sizeof(DrawTemplate));
+  }
+  if (ring.Flush(device->device_) != VK_SUCCESS) return 1;
+
+  // the depth of the occluder plane, cleared over the middle half of the
+  // screen, then the pyramid and both cullings
+  Vec4f occluder_clip = proj_view * Vec4f(0, 0, -OCCLUDER_DISTANCE, 1);
+  VkCommandBuffer command_buffer = device->BeginSingleTimeCommands();
+  VkClearValue clear_value{};
+  clear_value.depthStencil.depth = 1.0f;
+  VkRenderPassBeginInfo begin_info{};
+  begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  begin_info.renderPass = render_pass;
+  begin_info.framebuffer = framebuffer;
+  begin_info.renderArea.extent = {WIDTH, HEIGHT};
+  begin_info.clearValueCount = 1;
+  begin_info.pClearValues = &clear_value;
+  vkCmdBeginRenderPass(command_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+  VkClearAttachment occluder{};
+  occluder.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+  occluder.clearValue.depthStencil.depth = occluder_clip[2] / occluder_clip[3];
+  VkClearRect rect{};
+  rect.rect.offset = {int32_t(WIDTH / 4), int32_t(HEIGHT / 4)};
+  rect.rect.extent = {WIDTH / 2, HEIGHT / 2};
+  rect.layerCount = 1;
+  vkCmdClearAttachments(command_buffer, 1, &occluder, 1, &rect);
+  vkCmdEndRenderPass(command_buffer);
+  culler.RecordPyramid(command_buffer, 0, proj_view);
+  culler.RecordCulling(command_buffer, 0, n_instance, n_template);
+  culler.RecordCulling(command_buffer, 1, n_instance, n_template);
+  device->EndSingleTimeCommands(command_buffer);
+
+  // the reference: Culling::Cull, and the hidden boxes behind the occluder
+  std::vector<uint32_t> visible_indices;
+  Culling::Cull(bounds, planes, visible_indices);
+  std::vector<bool> visible(n_instance, false);
+  for (uint32_t i : visible_indices) visible[i] = true;
+  uint32_t n_frustum = n_instance - uint32_t(visible_indices.size());
+  uint32_t n_hidden = 0;
+  std::vector<bool> unoccluded = visible;
+  for (uint32_t i = 0; i < n_instance; ++i) {
+    if (hidden[i] && visible[i]) {
+      unoccluded[i] = false;
+      ++n_hidden;
+    }
+  }
+  if (n_hidden != N_HIDDEN) {
+    spdlog::error("{} of the {} hidden boxes in the frustum", n_hidden,
+                  N_HIDDEN);
+    return 1;
+  }
+
+  bool ok = true;
+  std::vector<uint8_t> region(static_cast<size_t>(frame_size));
+  const char* names[2] = {"frustum", "frustum and occlusion"};
+  for (uint32_t frame = 0; frame < 2; ++frame) {
+    ring.Read(device->device_, frame, 0, region.data(), frame_size);
+    ok &= Compare(names[frame], region, areas[GpuCuller::BINDING_STATE][0],
+                  areas[GpuCuller::BINDING_DRAW_SLOTS][0],
+                  areas[GpuCuller::BINDING_COMMANDS][0], culler.compact_,
+                  instances, ranges, templates, template_counts,
+                  frame == 0 ? visible : unoccluded, n_frustum,
+                  frame == 0 ? 0 : n_hidden);
+  }
+  spdlog::info("{} instances, {} visible on the CPU, {} commands{}", n_instance,
+               visible_indices.size(), n_template,
+               culler.compact_ ? " compacted" : "");
+
+  ring.Destroy(device->device_);
+  vkDestroyFramebuffer(device->device_, framebuffer, nullptr);
+  vkDestroyRenderPass(device->device_, render_pass, nullptr);
+  culler.Destroy(device->device_);
+  depth.Destroy(device->device_);
+  device->Destroy();
+  delete device;
+  vkDestroyInstance(instance, nullptr);
+  if (!ok) return 1;
+  spdlog::info("GPU culling matches");
+  return 0;
+}
\ No newline at end of file
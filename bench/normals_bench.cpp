@@ -0,0 +1,112 @@
+// Compares NormalSolver against the serial scatter-add loop that
+// MeshAsset::Init used before, on copies of an obj file's triangles, and
+// checks the octahedral encoding of the compact vertex format on the result.
+//   xmake build normals_bench && cd bin && ./normals_bench [obj] [copies] [runs]
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "benchutil.h"
+#include "helper/threadpool.h"
+#include "normals.h"
+#include "quantize.h"
+#include "scene/objloader.h"
+#include "scene/scene.h"
+
+using namespace Rain;
+
+namespace {
+void ScatterNormals(size_t n_vert, size_t n_face, const uint32_t* indices,
+                    const Vec3f* vertices, Vec3f* normals) {
+  for (size_t i = 0; i < n_vert; ++i) normals[i] = Vec3f::Zero();
+  for (size_t f = 0; f < n_face; ++f) {
+    uint32_t v1 = indices[3 * f];
+    uint32_t v2 = indices[3 * f + 1];
+    uint32_t v3 = indices[3 * f + 2];
+    Vec3f dx1 = vertices[v2] - vertices[v1];
+    Vec3f dx2 = vertices[v3] - vertices[v1];
+    Vec3f normal = (dx1.cross(dx2)).normalized();
+    normals[v1] += normal;
+    normals[v2] += normal;
+    normals[v3] += normal;
+  }
+  for (size_t i = 0; i < n_vert; ++i) normals[i] = normals[i].normalized();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  spdlog::set_pattern("[%^%l%$] %v");
+  std::string obj_file = argc > 1 ? argv[1] : "../assets/bunny/bunny.obj";
+  int copies = argc > 2 ? std::max(std::atoi(argv[2]), 1) : 16;
+  int runs = argc > 3 ? std::atoi(argv[3]) : 10;
+
+  MeshAsset obj;
+  if (!ObjLoader::Load(obj_file, &obj)) {
+    spdlog::error("failed to load {}", obj_file);
+    return 1;
+  }
+  // side by side copies, to get scan-sized meshes out of a small file
+  size_t n_vert = obj.n_vert_ * copies;
+  size_t n_face = obj.n_ele_ * copies;
+  std::vector<Vec3f> vertices(n_vert);
+  std::vector<uint32_t> indices(3 * n_face);
+  for (int k = 0; k < copies; ++k) {
+    for (size_t i = 0; i < obj.n_vert_; ++i) {
+      vertices[k * obj.n_vert_ + i] = obj.vertices_[i] + Vec3f(float(k), 0, 0);
+    }
+    for (size_t i = 0; i < 3 * obj.n_ele_; ++i) {
+      indices[k * 3 * obj.n_ele_ + i] =
+          uint32_t(k * obj.n_vert_ + obj.indices_[i]);
+    }
+  }
+  obj.Destroy();
+
+  std::vector<Vec3f> ref(n_vert), normals(n_vert);
+  NormalSolver solver;
+  double init_ms = BestMs(1, [&] {
+    solver.Init(n_vert, n_face, indices.data());
+  });
+  ScatterNormals(n_vert, n_face, indices.data(), vertices.data(), ref.data());
+  solver.Compute(vertices.data(), normals.data());
+  float max_error = 0.0f;
+  for (size_t i = 0; i < n_vert; ++i) {
+    max_error = std::max(max_error, (ref[i] - normals[i]).norm());
+  }
+  spdlog::info("{} x{}: {} vertices, {} triangles, max difference {:.2e}",
+               obj_file, copies, n_vert, n_face, max_error);
+
+  // through the 16-bit octahedral normals and back, as basic.vert decodes
+  std::vector<Quantize::Normal> encoded(n_vert);
+  Quantize::EncodeNormals(n_vert, normals.data(), encoded.data());
+  float max_angle = 0.0f;
+  for (size_t i = 0; i < n_vert; ++i) {
+    // vertices without a triangle have no normal
+    if (!(normals[i].squaredNorm() > 0.5f)) continue;
+    // acos loses the small angles to float rounding, atan2 keeps them
+    Vec3f decoded = Quantize::DecodeNormal(encoded[i]);
+    max_angle = std::max(max_angle,
+                         std::atan2(decoded.cross(normals[i]).norm(),
+                                    decoded.dot(normals[i])));
+  }
+  max_angle *= 180.0f / 3.14159265f;
+  spdlog::info("octahedral round trip: max error {:.4f} degrees", max_angle);
+
+  double scatter_ms = BestMs(runs, [&] {
+    ScatterNormals(n_vert, n_face, indices.data(), vertices.data(),
+                   ref.data());
+  });
+  double solver_ms = BestMs(runs, [&] {
+    solver.Compute(vertices.data(), normals.data());
+  });
+  spdlog::info("serial scatter-add: {:.2f} ms", scatter_ms);
+  spdlog::info("NormalSolver ({} threads): adjacency {:.2f} ms, per frame "
+               "{:.2f} ms ({:.1f}x)",
+               ThreadPool::Global().NumWorkers(), init_ms, solver_ms,
+               scatter_ms / solver_ms);
+  return max_error < 1e-4f && max_angle < 0.01f ? 0 : 1;
+}
\ No newline at end of file
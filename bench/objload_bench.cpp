@@ -0,0 +1,92 @@
+// Compares the chunked ObjLoader against the tinyobj::LoadObj path that
+// MeshAsset::Init used before, on the same file.
+//   xmake build objload_bench && cd bin && ./objload_bench [obj] [runs]
+#include <spdlog/spdlog.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+#include "benchutil.h"
+#include "helper/threadpool.h"
+#include "scene/objloader.h"
+#include "scene/scene.h"
+
+using namespace Rain;
+
+namespace {
+bool LoadTinyObj(const std::string& obj_file, MeshAsset& obj) {
+  tinyobj::attrib_t attrib;
+  std::vector<tinyobj::shape_t> shapes;
+  std::vector<tinyobj::material_t> materials;
+  std::string warn, err;
+  if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err,
+                        obj_file.c_str()))
+    return false;
+  obj.n_vert_ = attrib.vertices.size() / 3;
+  obj.vertices_ = new Vec3f[obj.n_vert_];
+  for (size_t i = 0; i < obj.n_vert_; ++i) {
+    obj.vertices_[i] = Vec3f(attrib.vertices[3 * i], attrib.vertices[3 * i + 1],
+                             attrib.vertices[3 * i + 2]);
+  }
+  if (attrib.normals.size() == 3 * obj.n_vert_) {
+    obj.normals_ = new Vec3f[obj.n_vert_];
+    for (size_t i = 0; i < obj.n_vert_; ++i) {
+      obj.normals_[i] = Vec3f(attrib.normals[3 * i], attrib.normals[3 * i + 1],
+                              attrib.normals[3 * i + 2]);
+    }
+  }
+  size_t n_index = 0;
+  for (const auto& shape : shapes) n_index += shape.mesh.indices.size();
+  obj.n_ele_ = n_index / 3;
+  obj.indices_ = new uint32_t[n_index];
+  size_t offset = 0;
+  for (const auto& shape : shapes) {
+    for (const auto& idx : shape.mesh.indices) {
+      obj.indices_[offset++] = idx.vertex_index;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  spdlog::set_pattern("[%^%l%$] %v");
+  std::string obj_file = argc > 1 ? argv[1] : "../assets/bunny/bunny.obj";
+  int runs = argc > 2 ? std::atoi(argv[2]) : 10;
+
+  MeshAsset ref, obj;
+  if (!LoadTinyObj(obj_file, ref) || !ObjLoader::Load(obj_file, &obj)) {
+    spdlog::error("failed to load {}", obj_file);
+    return 1;
+  }
+  bool same = ref.n_vert_ == obj.n_vert_ && ref.n_ele_ == obj.n_ele_ &&
+              memcmp(ref.indices_, obj.indices_,
+                     3 * obj.n_ele_ * sizeof(uint32_t)) == 0;
+  for (size_t i = 0; same && i < obj.n_vert_; ++i) {
+    same = (ref.vertices_[i] - obj.vertices_[i]).norm() <=
+           1e-6f * (1.0f + ref.vertices_[i].norm());
+  }
+  spdlog::info("{}: {} vertices, {} triangles, results {}", obj_file,
+               obj.n_vert_, obj.n_ele_, same ? "match" : "DIFFER");
+  ref.Destroy();
+  obj.Destroy();
+
+  double tiny_ms = BestMs(runs, [&] {
+    MeshAsset mesh;
+    LoadTinyObj(obj_file, mesh);
+  });
+  double chunked_ms = BestMs(runs, [&] {
+    MeshAsset mesh;
+    ObjLoader::Load(obj_file, &mesh);
+  });
+  spdlog::info("tinyobj::LoadObj + copy: {:.2f} ms", tiny_ms);
+  spdlog::info("ObjLoader ({} threads): {:.2f} ms ({:.1f}x)",
+               ThreadPool::Global().NumWorkers(), chunked_ms,
+               tiny_ms / chunked_ms);
+  return same ? 0 : 1;
+}
\ No newline at end of file
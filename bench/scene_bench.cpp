@@ -0,0 +1,78 @@
+// Writes a text scene with many bunnies, then times loading it as text and
+// as binary.
+//   xmake build scene_bench && cd bin && ./scene_bench [objects] [runs]
+#include <spdlog/spdlog.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <string>
+
+#include "benchutil.h"
+#include "helper/threadpool.h"
+#include "scene/scene.h"
+#include "scene/sceneloader.h"
+
+using namespace Rain;
+
+int main(int argc, char** argv) {
+  spdlog::set_pattern("[%^%l%$] %v");
+  size_t n_object = argc > 1 ? std::atoll(argv[1]) : 100000;
+  int runs = argc > 2 ? std::atoi(argv[2]) : 5;
+  std::string text_file = "../assets/scenes/bench.rscene";
+  std::string binary_file = "../assets/scenes/bench.rsb";
+
+  {
+    std::ofstream file(text_file);
+    file << "mesh bunny ../bunny/bunny.obj\n";
+    file << "material red Ka 0.8 0.1 0.1 Kd 0.8 0.1 0.1\n";
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> pos(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> angle(0.0f, 360.0f);
+    for (size_t i = 0; i < n_object; ++i) {
+      file << "object bunny " << pos(rng) << ' ' << pos(rng) << ' '
+           << pos(rng) << " 0 " << angle(rng) << " 0 1"
+           << (i % 2 ? " red\n" : "\n");
+    }
+  }
+
+  // keeps the bunny loaded, the timed scenes only parse placements
+  Scene warm;
+  if (!warm.Init(text_file) || !SceneLoader::SaveBinary(binary_file, warm)) {
+    spdlog::error("failed to write {}", binary_file);
+    return 1;
+  }
+  Scene binary;
+  binary.meshes_ = warm.meshes_;
+  SceneLoader::Load(binary_file, &binary);
+  bool same = binary.objects_.size() == warm.objects_.size();
+  for (size_t i = 0; same && i < warm.objects_.size(); ++i) {
+    same = binary.objects_[i].transformation_ ==
+               warm.objects_[i].transformation_ &&
+           binary.objects_[i].mesh_ == warm.objects_[i].mesh_ &&
+           binary.objects_[i].override_material_ ==
+               warm.objects_[i].override_material_;
+  }
+  spdlog::info("{} objects, text and binary {}", n_object,
+               same ? "match" : "DIFFER");
+  binary.Destroy();
+
+  auto level = spdlog::get_level();
+  spdlog::set_level(spdlog::level::warn);
+  double text_ms = BestMs(runs, [&] {
+    Scene scene;
+    scene.meshes_ = warm.meshes_;
+    scene.Init(text_file);
+  });
+  double binary_ms = BestMs(runs, [&] {
+    Scene scene;
+    scene.meshes_ = warm.meshes_;
+    scene.Init(binary_file);
+  });
+  spdlog::set_level(level);
+  spdlog::info("text ({} threads): {:.2f} ms", ThreadPool::Global().NumWorkers(),
+               text_ms);
+  spdlog::info("binary: {:.2f} ms", binary_ms);
+  warm.Destroy();
+  return same ? 0 : 1;
+}
\ No newline at end of file
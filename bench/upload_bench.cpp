@@ -0,0 +1,153 @@
+// Uploads many device local buffers through a staging buffer and a queue
+// idle per buffer, the way Buffer::Update used to, then through the batched
+// Uploader, and reports the throughput of both. Runs headless on the first
+// physical device with a graphics queue.
+//   xmake build upload_bench && cd bin && ./upload_bench [buffers] [KB]
+#include <spdlog/spdlog.h>
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "buffer/buffer.h"
+#include "device/device.h"
+
+using namespace Rain;
+
+namespace {
+// one staging buffer, one submit and one queue idle per upload
+VkResult UploadBlocking(Device* device, VkBuffer dst, const void* data,
+                        VkDeviceSize size) {
+  VkBufferCreateInfo buffer_info{};
+  buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_info.size = size;
+  buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  VkBuffer staging;
+  VkResult result =
+      vkCreateBuffer(device->device_, &buffer_info, nullptr, &staging);
+  if (result != VK_SUCCESS) return result;
+  VkMemoryRequirements mem_req;
+  vkGetBufferMemoryRequirements(device->device_, staging, &mem_req);
+  VkMemoryAllocateInfo alloc_info{};
+  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  alloc_info.allocationSize = mem_req.size;
+  alloc_info.memoryTypeIndex = device->FindMemoryTypeIndex(
+      mem_req.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                  VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  VkDeviceMemory memory;
+  result = vkAllocateMemory(device->device_, &alloc_info, nullptr, &memory);
+  if (result != VK_SUCCESS) return result;
+  vkBindBufferMemory(device->device_, staging, memory, 0);
+  void* mapped;
+  vkMapMemory(device->device_, memory, 0, size, 0, &mapped);
+  memcpy(mapped, data, size_t(size));
+  vkUnmapMemory(device->device_, memory);
+
+  VkCommandBuffer command_buffer = device->BeginSingleTimeCommands();
+  VkBufferCopy region{};
+  region.size = size;
+  vkCmdCopyBuffer(command_buffer, staging, dst, 1, &region);
+  device->EndSingleTimeCommands(command_buffer);
+  vkDestroyBuffer(device->device_, staging, nullptr);
+  vkFreeMemory(device->device_, memory, nullptr);
+  return VK_SUCCESS;
+}
+
+bool CreateDevice(VkInstance& instance, Device& device) {
+  VkApplicationInfo app_info{};
+  app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+  app_info.pApplicationName = "upload_bench";
+  app_info.apiVersion = VK_API_VERSION_1_0;
+  VkInstanceCreateInfo instance_info{};
+  instance_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+  instance_info.pApplicationInfo = &app_info;
+  if (vkCreateInstance(&instance_info, nullptr, &instance) != VK_SUCCESS) {
+    return false;
+  }
+  uint32_t n_physical = 0;
+  vkEnumeratePhysicalDevices(instance, &n_physical, nullptr);
+  std::vector<VkPhysicalDevice> physicals(n_physical);
+  vkEnumeratePhysicalDevices(instance, &n_physical, physicals.data());
+  for (VkPhysicalDevice physical : physicals) {
+    uint32_t n_family = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical, &n_family, nullptr);
+    std::vector<VkQueueFamilyProperties> families(n_family);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical, &n_family,
+                                             families.data());
+    uint32_t graphics = UINT32_MAX;
+    uint32_t transfer = UINT32_MAX;
+    for (uint32_t i = 0; i < n_family; ++i) {
+      VkQueueFlags flags = families[i].queueFlags;
+      if ((flags & VK_QUEUE_GRAPHICS_BIT) && graphics == UINT32_MAX) {
+        graphics = i;
+      } else if ((flags & VK_QUEUE_TRANSFER_BIT) &&
+                 !(flags & VK_QUEUE_GRAPHICS_BIT) &&
+                 (transfer == UINT32_MAX || !(flags & VK_QUEUE_COMPUTE_BIT))) {
+        transfer = i;
+      }
+    }
+    if (graphics == UINT32_MAX) continue;
+    if (transfer == UINT32_MAX) transfer = graphics;
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(physical, &props);
+    spdlog::info("device: {}, transfer queue family {}", props.deviceName,
+                 transfer);
+    return device.Init(physical, graphics, graphics, transfer, nullptr,
+                       nullptr) == VK_SUCCESS;
+  }
+  return false;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  spdlog::set_pattern("[%^%l%$] %v");
+  size_t n_buffer = argc > 1 ? std::atoll(argv[1]) : 1000;
+  size_t size = (argc > 2 ? std::atoll(argv[2]) : 256) * 1024;
+
+  VkInstance instance = VK_NULL_HANDLE;
+  Device* device = new Device;
+  if (!CreateDevice(instance, *device)) {
+    spdlog::error("no vulkan device with a graphics queue");
+    return 1;
+  }
+  std::vector<char> data(size);
+  for (size_t i = 0; i < size; ++i) data[i] = char(i * 31);
+  std::vector<Buffer> buffers(n_buffer);
+  for (auto& buffer : buffers) {
+    buffer.AllocateDeviceLocal(device, nullptr, size,
+                               VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+  }
+  double mb = double(n_buffer) * size / (1 << 20);
+
+  auto start = std::chrono::steady_clock::now();
+  for (auto& buffer : buffers) {
+    UploadBlocking(device, buffer.buffer_, data.data(), size);
+  }
+  std::chrono::duration<double, std::milli> blocking =
+      std::chrono::steady_clock::now() - start;
+
+  uint64_t n_submit = device->uploader_.stats_.n_submit_;
+  start = std::chrono::steady_clock::now();
+  for (auto& buffer : buffers) {
+    buffer.Update(device, data.data(), size);
+  }
+  device->uploader_.Flush();
+  std::chrono::duration<double, std::milli> batched =
+      std::chrono::steady_clock::now() - start;
+  n_submit = device->uploader_.stats_.n_submit_ - n_submit;
+
+  spdlog::info("{} buffers of {} KB, {:.1f} MB", n_buffer, size / 1024, mb);
+  spdlog::info("blocking: {:8.2f} ms {:8.1f} MB/s, {} submits",
+               blocking.count(), mb / blocking.count() * 1000.0, n_buffer);
+  spdlog::info("batched:  {:8.2f} ms {:8.1f} MB/s, {} submits",
+               batched.count(), mb / batched.count() * 1000.0, n_submit);
+
+  for (auto& buffer : buffers) buffer.Destroy(device->device_);
+  device->Destroy();
+  delete device;
+  vkDestroyInstance(instance, nullptr);
+  return 0;
+}
\ No newline at end of file
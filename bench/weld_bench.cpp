@@ -0,0 +1,94 @@
+// Compares Weld::Build against a std::unordered_map keyed by the index
+// triplet, on corner streams made from the triangles of an obj file.
+//   xmake build weld_bench && cd bin && ./weld_bench [obj] [runs]
+#include <spdlog/spdlog.h>
+
+#include <array>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "benchutil.h"
+#include "helper/threadpool.h"
+#include "scene/objloader.h"
+#include "scene/scene.h"
+#include "weld.h"
+
+using namespace Rain;
+
+namespace {
+struct TripletHash {
+  size_t operator()(const std::array<uint32_t, 3>& key) const {
+    return (size_t(key[0]) * 0x9E3779B97F4A7C15ull) ^
+           (size_t(key[1]) * 0xC2B2AE3D27D4EB4Full) ^
+           (size_t(key[2]) * 0x165667B19E3779F9ull);
+  }
+};
+
+uint32_t BuildUnorderedMap(size_t n_corner, const uint32_t* v,
+                           const uint32_t* vt, const uint32_t* vn,
+                           uint32_t* remap, std::vector<uint32_t>& first) {
+  std::unordered_map<std::array<uint32_t, 3>, uint32_t, TripletHash> map;
+  first.clear();
+  for (size_t c = 0; c < n_corner; ++c) {
+    auto it = map.try_emplace({v[c], vt[c], vn[c]}, uint32_t(first.size()));
+    if (it.second) first.push_back(uint32_t(c));
+    remap[c] = it.first->second;
+  }
+  return uint32_t(first.size());
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  spdlog::set_pattern("[%^%l%$] %v");
+  std::string obj_file = argc > 1 ? argv[1] : "../assets/bunny/bunny.obj";
+  int runs = argc > 2 ? std::atoi(argv[2]) : 10;
+
+  MeshAsset obj;
+  if (!ObjLoader::Load(obj_file, &obj)) {
+    spdlog::error("failed to load {}", obj_file);
+    return 1;
+  }
+  size_t n_corner = 3 * obj.n_ele_;
+  const uint32_t* v = obj.indices_;
+  // "smooth" is what scanners usually export (f 1/1/1), "flat" gives every
+  // triangle its own normal and splits every corner
+  std::vector<uint32_t> smooth(v, v + n_corner);
+  std::vector<uint32_t> flat(n_corner);
+  for (size_t c = 0; c < n_corner; ++c) flat[c] = uint32_t(c / 3);
+
+  bool same = true;
+  for (auto* vn : {&smooth, &flat}) {
+    const char* name = vn == &smooth ? "smooth" : "flat";
+    std::vector<uint32_t> remap(n_corner), ref_remap(n_corner);
+    std::vector<uint32_t> first, ref_first;
+    uint32_t n_vert = Weld::Build(n_corner, v, smooth.data(), vn->data(),
+                                  remap.data(), first);
+    uint32_t ref_n_vert = BuildUnorderedMap(n_corner, v, smooth.data(),
+                                            vn->data(), ref_remap.data(),
+                                            ref_first);
+    bool match = n_vert == ref_n_vert && remap == ref_remap &&
+                 first == ref_first;
+    same = same && match;
+    double map_ms = BestMs(runs, [&] {
+      BuildUnorderedMap(n_corner, v, smooth.data(), vn->data(),
+                        ref_remap.data(), ref_first);
+    });
+    double weld_ms = BestMs(runs, [&] {
+      Weld::Build(n_corner, v, smooth.data(), vn->data(), remap.data(),
+                  first);
+    });
+    spdlog::info("{} {}: {} corners -> {} vertices ({:.2f} corners per "
+                 "vertex), results {}",
+                 obj_file, name, n_corner, n_vert, double(n_corner) / n_vert,
+                 match ? "match" : "DIFFER");
+    spdlog::info("  std::unordered_map: {:.2f} ms", map_ms);
+    spdlog::info("  Weld::Build ({} threads): {:.2f} ms ({:.1f}x)",
+                 ThreadPool::Global().NumWorkers(), weld_ms,
+                 map_ms / weld_ms);
+  }
+  obj.Destroy();
+  return same ? 0 : 1;
+}
\ No newline at end of file
@@ -1,5 +1,13 @@
 echo "Vulkan sdk's location:"
 echo $VULKAN_SDK
+# Bin/glslc.exe in the Windows SDK, bin/glslc in the Linux one, else PATH
+GLSLC=glslc
+if [ -x "$VULKAN_SDK/Bin/glslc.exe" ]; then
+  GLSLC="$VULKAN_SDK/Bin/glslc.exe"
+elif [ -x "$VULKAN_SDK/bin/glslc" ]; then
+  GLSLC="$VULKAN_SDK/bin/glslc"
+fi
+echo "using $GLSLC"
 echo "create outputdir"
 mkdir -p bin/shaders
 echo "start compiling"
@@ -7,12 +15,18 @@ for file in shaders/*.vert
 do
   output_file=`echo $file | sed -E "s/shaders\/(\S*)\.(\S*)/bin\/shaders\/\1_\2\.spv/"`
   echo compile $file
-  $VULKAN_SDK/Bin/glslc.exe $file -o $output_file
+  "$GLSLC" $file -o $output_file
 done
 for file in shaders/*.frag
 do
   output_file=`echo $file | sed -E "s/shaders\/(\S*)\.(\S*)/bin\/shaders\/\1_\2\.spv/"`
   echo compile $file
-  $VULKAN_SDK/Bin/glslc.exe $file -o $output_file
+  "$GLSLC" $file -o $output_file
 done
-echo "finish compiling"
+for file in shaders/*.comp
+do
+  output_file=`echo $file | sed -E "s/shaders\/(\S*)\.(\S*)/bin\/shaders\/\1_\2\.spv/"`
+  echo compile $file
+  "$GLSLC" $file -o $output_file
+done
+echo "finish compiling"
\ No newline at end of file
@@ -1,6 +1,10 @@
 #version 450
 
-layout(location = 0) in vec3 inPosition;
+// VERTEX_FORMAT_COMPACT of RenderModel: unorm positions within the bounding
+// box and octahedral normals, otherwise plain floats
+layout(constant_id = 0) const bool COMPACT_VERTEX = false;
+
+layout(location = 0) in vec4 inPosition;
 layout(location = 1) in vec3 inNormal;
 
 layout(binding = 0) uniform GlobalUniformData {
@@ -10,17 +14,62 @@ layout(binding = 0) uniform GlobalUniformData {
     vec3 light_dir;
 } global_data;
 
-layout(binding = 1) uniform ModelUniformData {
+struct InstanceData {
+  mat4 model_;
+  vec4 bbox_min_;
+  vec4 bbox_extent_;
+  // draw ranges and material slots, read by cull.comp
+  uint first_range_;
+  uint n_range_;
+  uint first_material_;
+  uint stride_;
+};
+
+struct MaterialData {
   vec4 Ka_d_;
   vec4 Kd_;
   vec4 Ks_Ns_;
-  mat4 model_; // don't use
-} model_data;
+  uint instance_;
+};
+
+// one slot per resident model
+layout(std430, binding = 1) readonly buffer InstanceBuffer {
+  InstanceData slots[];
+} instance_buffer;
+
+// one slot per draw range of every resident model
+layout(std430, binding = 2) readonly buffer MaterialBuffer {
+  MaterialData slots[];
+} material_buffer;
+
+// material slots of the visible instances, indexed by the instance index
+// of the draws
+layout(std430, binding = 3) readonly buffer DrawSlots {
+  uint slots[];
+} draw_slots;
 
 layout(location = 0) out vec3 fragColor;
 
+vec3 OctDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+    return normalize(n);
+}
+
 void main() {
-    gl_Position = global_data.proj_view * vec4(inPosition, 1.0);
-    float diff = max(dot(inNormal, -global_data.light_dir), 0.0);
-    fragColor = (global_data.ambient + global_data.directional * diff) * model_data.Ka_d_.rgb;
+    MaterialData material =
+        material_buffer.slots[draw_slots.slots[gl_InstanceIndex]];
+    InstanceData instance = instance_buffer.slots[material.instance_];
+    vec3 position = inPosition.xyz;
+    vec3 normal = inNormal;
+    if (COMPACT_VERTEX) {
+        position = instance.bbox_min_.xyz + position * instance.bbox_extent_.xyz;
+        normal = OctDecode(inNormal.xy);
+    }
+    // model_ is a rotation with uniform scale, it keeps normals orthogonal
+    gl_Position = global_data.proj_view * instance.model_ * vec4(position, 1.0);
+    normal = normalize(mat3(instance.model_) * normal);
+    float diff = max(dot(normal, -global_data.light_dir), 0.0);
+    fragColor = (global_data.ambient + global_data.directional * diff) * material.Ka_d_.rgb;
 }
\ No newline at end of file
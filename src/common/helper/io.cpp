@@ -1,5 +1,17 @@
 #include "io.h"
 
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace Rain::IO {
 std::vector<char> ReadFile(const std::string& filename){
   std::ifstream file(filename, std::ios::ate | std::ios::binary);
@@ -13,4 +25,81 @@ std::vector<char> ReadFile(const std::string& filename){
   file.close();
   return buffer;
 };
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+  if (this != &other) {
+    Close();
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+  }
+  return *this;
+}
+
+MappedFile::~MappedFile() { Close(); }
+
+bool MappedFile::Open(const std::string& filename, bool copy_on_write) {
+  Close();
+#ifdef _WIN32
+  HANDLE file = CreateFileA(
+      filename.c_str(), GENERIC_READ,
+      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) return false;
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
+  }
+  HANDLE mapping =
+      CreateFileMappingA(file, nullptr,
+                         copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0,
+                         nullptr);
+  CloseHandle(file);
+  if (!mapping) return false;
+  void* data = MapViewOfFile(mapping, copy_on_write ? FILE_MAP_COPY
+                                                    : FILE_MAP_READ,
+                             0, 0, 0);
+  CloseHandle(mapping);
+  if (!data) return false;
+  size_ = size_t(file_size.QuadPart);
+#else
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return false;
+  }
+  int prot = copy_on_write ? (PROT_READ | PROT_WRITE) : PROT_READ;
+  void* data = mmap(nullptr, size_t(st.st_size), prot, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return false;
+  size_ = size_t(st.st_size);
+#endif
+  data_ = static_cast<const char*>(data);
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_) Unmap(const_cast<char*>(data_), size_);
+  data_ = nullptr;
+  size_ = 0;
+}
+
+void* MappedFile::Release() {
+  size_ = 0;
+  return const_cast<char*>(std::exchange(data_, nullptr));
+}
+
+void MappedFile::Unmap(void* data, size_t size) {
+#ifdef _WIN32
+  UnmapViewOfFile(data);
+#else
+  munmap(data, size);
+#endif
+}
 };
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <fstream>
 #include <string>
 #include <vector>
@@ -7,5 +8,31 @@
 namespace Rain {
 namespace IO {
 std::vector<char> ReadFile(const std::string& filename);
+
+// Read-only view of a whole file backed by mmap, unmapped on destruction.
+// Opening a missing file costs a single failed open and no allocation.
+class MappedFile {
+ public:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+
+  MappedFile() = default;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+  ~MappedFile();
+
+  // copy_on_write maps the pages writable but private, writes never reach
+  // the file; empty files fail to open
+  bool Open(const std::string& filename, bool copy_on_write = false);
+  void Close();
+  bool IsOpen() const { return data_ != nullptr; }
+  const char* begin() const { return data_; }
+  const char* end() const { return data_ + size_; }
+  // gives up ownership, free it later with Unmap(data, size)
+  void* Release();
+  static void Unmap(void* data, size_t size);
 };
+};  // namespace IO
 };  // namespace Rain
\ No newline at end of file
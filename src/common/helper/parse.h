@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+namespace Rain {
+// line oriented helpers shared by the text asset loaders, they work on
+// [p, end) ranges of a mapped file and never read past end
+namespace Parse {
+inline bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+inline bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+inline bool IsKeyword(const char* p, const char* end, const char* keyword,
+                      size_t length) {
+  return size_t(end - p) > length && memcmp(p, keyword, length) == 0 &&
+         IsSpace(p[length]);
+}
+
+inline const char* SkipSpace(const char* p, const char* end) {
+  while (p < end && IsSpace(*p)) ++p;
+  return p;
+}
+
+inline const char* NextLine(const char* p, const char* end) {
+  const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+  return nl ? nl + 1 : end;
+}
+
+// rest of the line without surrounding spaces
+inline std::string_view GetName(const char* p, const char* line_end) {
+  p = SkipSpace(p, line_end);
+  const char* q = line_end;
+  while (q > p && (IsSpace(q[-1]) || q[-1] == '\n')) --q;
+  return std::string_view(p, q - p);
+}
+
+inline size_t CountTokens(const char* p, const char* end) {
+  size_t n = 0;
+  while (true) {
+    p = SkipSpace(p, end);
+    if (p >= end || *p == '\n' || *p == '#') break;
+    ++n;
+    while (p < end && !IsSpace(*p) && *p != '\n') ++p;
+  }
+  return n;
+}
+
+// locale independent and much faster than strtof, exact for the usual
+// "-0.123456" style numbers found in text assets
+inline const char* ParseFloat(const char* p, const char* end, float& out) {
+  static const double pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                 1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                 1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                 1e18, 1e19, 1e20, 1e21, 1e22};
+  p = SkipSpace(p, end);
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    ++p;
+  }
+  uint64_t mantissa = 0;
+  int exponent = 0;
+  int n_digit = 0;
+  bool any_digit = false;
+  for (; p < end && IsDigit(*p); ++p) {
+    any_digit = true;
+    if (n_digit < 19) {
+      mantissa = mantissa * 10 + (*p - '0');
+      if (mantissa) ++n_digit;
+    } else {
+      ++exponent;
+    }
+  }
+  if (p < end && *p == '.') {
+    for (++p; p < end && IsDigit(*p); ++p) {
+      any_digit = true;
+      if (n_digit < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        if (mantissa) ++n_digit;
+        --exponent;
+      }
+    }
+  }
+  if (!any_digit) return nullptr;
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    ++p;
+    bool exp_negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+      exp_negative = *p == '-';
+      ++p;
+    }
+    int e = 0;
+    for (; p < end && IsDigit(*p); ++p) {
+      if (e < 10000) e = e * 10 + (*p - '0');
+    }
+    exponent += exp_negative ? -e : e;
+  }
+  double value = double(mantissa);
+  if (exponent < 0) {
+    value = (-exponent <= 22) ? value / pow10[-exponent]
+                              : value * std::pow(10.0, exponent);
+  } else if (exponent > 0) {
+    value = (exponent <= 22) ? value * pow10[exponent]
+                             : value * std::pow(10.0, exponent);
+  }
+  out = float(negative ? -value : value);
+  return p;
+}
+
+inline const char* ParseInt(const char* p, const char* end, int64_t& out) {
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    ++p;
+  }
+  if (p >= end || !IsDigit(*p)) return nullptr;
+  int64_t value = 0;
+  for (; p < end && IsDigit(*p); ++p) value = value * 10 + (*p - '0');
+  out = negative ? -value : value;
+  return p;
+}
+
+// next whitespace separated token of the line, nullptr when there is none
+inline const char* ParseToken(const char* p, const char* end,
+                              std::string_view& out) {
+  p = SkipSpace(p, end);
+  if (p >= end || *p == '\n' || *p == '#') return nullptr;
+  const char* q = p;
+  while (q < end && !IsSpace(*q) && *q != '\n') ++q;
+  out = std::string_view(p, q - p);
+  return q;
+}
+
+// n + 1 bounds of n pieces of about equal size that start at line starts
+inline std::vector<const char*> SplitLines(const char* data, const char* end,
+                                           size_t n) {
+  std::vector<const char*> bounds(n + 1);
+  size_t size = end - data;
+  const char* p = data;
+  bounds[0] = data;
+  for (size_t i = 0; i < n; ++i) {
+    const char* q = data + size * (i + 1) / n;
+    if (q < p) q = p;
+    if (q > data && q < end) q = NextLine(q - 1, end);
+    bounds[i + 1] = q;
+    p = q;
+  }
+  return bounds;
+}
+};  // namespace Parse
+};  // namespace Rain
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "threadpool.h"
+
+#include <algorithm>
+
+namespace Rain {
+ThreadPool::ThreadPool(uint32_t n_threads) {
+  for (uint32_t i = 0; i < n_threads; ++i) {
+    threads_.emplace_back(&ThreadPool::WorkerLoop, this, i + 1);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  job_cv_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void ThreadPool::ParallelFor(size_t n, size_t grain, const RangeFunc& fn) {
+  if (n == 0) return;
+  grain = std::max<size_t>(grain, 1);
+  size_t n_chunk = (n + grain - 1) / grain;
+  if (n_chunk == 1 || threads_.empty()) {
+    fn(0, n, 0);
+    return;
+  }
+  Job job;
+  job.fn_ = &fn;
+  job.n_ = n;
+  job.grain_ = grain;
+  job.n_chunk_ = n_chunk;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(&job);
+  }
+  job_cv_.notify_all();
+  RunChunks(&job, 0);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = std::find(jobs_.begin(), jobs_.end(), &job);
+  if (it != jobs_.end()) jobs_.erase(it);
+  done_cv_.wait(lock, [&job] {
+    return job.active_ == 0 && job.done_.load() == job.n_chunk_;
+  });
+}
+
+void ThreadPool::WorkerLoop(uint32_t worker) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    job_cv_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+    if (stop_) return;
+    Job* job = jobs_.front();
+    ++job->active_;
+    lock.unlock();
+    RunChunks(job, worker);
+    lock.lock();
+    // every chunk is taken, stop handing this job out
+    auto it = std::find(jobs_.begin(), jobs_.end(), job);
+    if (it != jobs_.end()) jobs_.erase(it);
+    if (--job->active_ == 0 && job->done_.load() == job->n_chunk_) {
+      done_cv_.notify_all();
+    }
+  }
+}
+
+void ThreadPool::RunChunks(Job* job, uint32_t worker) {
+  size_t chunk;
+  while ((chunk = job->next_++) < job->n_chunk_) {
+    size_t begin = chunk * job->grain_;
+    size_t end = std::min(job->n_, begin + job->grain_);
+    (*job->fn_)(begin, end, worker);
+    ++job->done_;
+  }
+}
+
+ThreadPool& ThreadPool::Global() {
+  static ThreadPool pool(
+      std::max(std::thread::hardware_concurrency(), 1u) - 1);
+  return pool;
+}
+};  // namespace Rain
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Rain {
+class ThreadPool {
+ public:
+  // fn(begin, end, worker): worker is 0 for the calling thread and 1..n for
+  // pool threads, so it can index per-worker data sized by NumWorkers()
+  using RangeFunc = std::function<void(size_t, size_t, uint32_t)>;
+
+  struct Job {
+    const RangeFunc* fn_;
+    size_t n_;
+    size_t grain_;
+    size_t n_chunk_;
+    std::atomic<size_t> next_{0};
+    std::atomic<size_t> done_{0};
+    uint32_t active_ = 0;  // workers holding this job, guarded by mutex_
+  };
+
+  std::vector<std::thread> threads_;
+  std::deque<Job*> jobs_;
+  std::mutex mutex_;
+  std::condition_variable job_cv_;
+  std::condition_variable done_cv_;
+  bool stop_ = false;
+
+  explicit ThreadPool(uint32_t n_threads);
+  ~ThreadPool();
+  uint32_t NumWorkers() const { return uint32_t(threads_.size()) + 1; }
+  // split [0, n) into chunks of grain elements, the caller works too and
+  // returns when every chunk is done
+  void ParallelFor(size_t n, size_t grain, const RangeFunc& fn);
+  void WorkerLoop(uint32_t worker);
+  void RunChunks(Job* job, uint32_t worker);
+
+  static ThreadPool& Global();
+};
+};  // namespace Rain
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include "culling.h"
+
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define RAIN_CULL_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RAIN_CULL_SSE
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace Rain {
+namespace {
+#if defined(RAIN_CULL_AVX)
+const uint32_t N_LANE = 8;
+#elif defined(RAIN_CULL_SSE)
+const uint32_t N_LANE = 4;
+#else
+const uint32_t N_LANE = 1;
+#endif
+
+// far below any plane distance, so an empty box is outside of every plane
+const float EMPTY_EXTENT = -1e30f;
+
+inline uint32_t Ctz(uint32_t x) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, x);
+  return uint32_t(index);
+#else
+  return uint32_t(__builtin_ctz(x));
+#endif
+}
+
+// a box is outside when its farthest corner along a plane normal is behind
+// the plane
+inline bool BoxInside(const BoundsTable& bounds, size_t i,
+                      const Vec4f planes[6]) {
+  for (int p = 0; p < 6; ++p) {
+    const Vec4f& plane = planes[p];
+    float d = plane[3];
+    for (int k = 0; k < 3; ++k) {
+      d += plane[k] * bounds.center_[k][i] +
+           std::abs(plane[k]) * bounds.extent_[k][i];
+    }
+    if (d < 0.0f) return false;
+  }
+  return true;
+}
+}  // namespace
+
+void BoundsTable::Resize(size_t n) {
+  size_ = n;
+  size_t padded = (n + N_LANE - 1) / N_LANE * N_LANE;
+  for (int k = 0; k < 3; ++k) {
+    center_[k].assign(padded, 0.0f);
+    extent_[k].assign(padded, EMPTY_EXTENT);
+  }
+}
+
+void BoundsTable::Set(size_t i, const Vec3f& bbox_min,
+                      const Vec3f& bbox_max) {
+  for (int k = 0; k < 3; ++k) {
+    center_[k][i] = 0.5f * (bbox_min[k] + bbox_max[k]);
+    extent_[k][i] = 0.5f * (bbox_max[k] - bbox_min[k]);
+  }
+}
+
+void BoundsTable::SetEmpty(size_t i) {
+  for (int k = 0; k < 3; ++k) {
+    center_[k][i] = 0.0f;
+    extent_[k][i] = EMPTY_EXTENT;
+  }
+}
+
+namespace Culling {
+const uint32_t LANES = N_LANE;
+
+void ExtractPlanes(const Mat4f& proj_view, Vec4f planes[6]) {
+  Vec4f r0 = proj_view.row(0).transpose();
+  Vec4f r1 = proj_view.row(1).transpose();
+  Vec4f r2 = proj_view.row(2).transpose();
+  Vec4f r3 = proj_view.row(3).transpose();
+  planes[0] = r3 + r0;
+  planes[1] = r3 - r0;
+  planes[2] = r3 + r1;
+  planes[3] = r3 - r1;
+  planes[4] = r2;  // z >= 0
+  planes[5] = r3 - r2;
+  for (int p = 0; p < 6; ++p) {
+    planes[p] /= planes[p].head<3>().norm();
+  }
+}
+
+void CullScalar(const BoundsTable& bounds, const Vec4f planes[6],
+                std::vector<uint32_t>& visible) {
+  visible.clear();
+  for (size_t i = 0; i < bounds.size_; ++i) {
+    if (BoxInside(bounds, i, planes)) visible.push_back(uint32_t(i));
+  }
+}
+
+#if defined(RAIN_CULL_AVX) || defined(RAIN_CULL_SSE)
+namespace {
+#if defined(RAIN_CULL_AVX)
+using Lane = __m256;
+inline Lane Set1(float x) { return _mm256_set1_ps(x); }
+inline Lane Load(const float* p) { return _mm256_loadu_ps(p); }
+inline Lane Add(Lane a, Lane b) { return _mm256_add_ps(a, b); }
+inline Lane Mul(Lane a, Lane b) { return _mm256_mul_ps(a, b); }
+inline Lane And(Lane a, Lane b) { return _mm256_and_ps(a, b); }
+inline Lane GreaterEqual(Lane a, Lane b) {
+  return _mm256_cmp_ps(a, b, _CMP_GE_OQ);
+}
+inline uint32_t MoveMask(Lane a) { return uint32_t(_mm256_movemask_ps(a)); }
+#else
+using Lane = __m128;
+inline Lane Set1(float x) { return _mm_set1_ps(x); }
+inline Lane Load(const float* p) { return _mm_loadu_ps(p); }
+inline Lane Add(Lane a, Lane b) { return _mm_add_ps(a, b); }
+inline Lane Mul(Lane a, Lane b) { return _mm_mul_ps(a, b); }
+inline Lane And(Lane a, Lane b) { return _mm_and_ps(a, b); }
+inline Lane GreaterEqual(Lane a, Lane b) { return _mm_cmpge_ps(a, b); }
+inline uint32_t MoveMask(Lane a) { return uint32_t(_mm_movemask_ps(a)); }
+#endif
+}  // namespace
+
+void Cull(const BoundsTable& bounds, const Vec4f planes[6],
+          std::vector<uint32_t>& visible) {
+  visible.clear();
+  // the planes and their absolute values, broadcast once
+  Lane n[6][3], abs_n[6][3], d[6];
+  for (int p = 0; p < 6; ++p) {
+    for (int k = 0; k < 3; ++k) {
+      n[p][k] = Set1(planes[p][k]);
+      abs_n[p][k] = Set1(std::abs(planes[p][k]));
+    }
+    d[p] = Set1(planes[p][3]);
+  }
+  const Lane zero = Set1(0.0f);
+  const float* cx = bounds.center_[0].data();
+  const float* cy = bounds.center_[1].data();
+  const float* cz = bounds.center_[2].data();
+  const float* ex = bounds.extent_[0].data();
+  const float* ey = bounds.extent_[1].data();
+  const float* ez = bounds.extent_[2].data();
+  for (size_t i = 0; i < bounds.size_; i += N_LANE) {
+    Lane c[3] = {Load(cx + i), Load(cy + i), Load(cz + i)};
+    Lane e[3] = {Load(ex + i), Load(ey + i), Load(ez + i)};
+    Lane inside = GreaterEqual(zero, zero);
+    for (int p = 0; p < 6; ++p) {
+      Lane dist = d[p];
+      for (int k = 0; k < 3; ++k) {
+        dist = Add(dist, Add(Mul(n[p][k], c[k]), Mul(abs_n[p][k], e[k])));
+      }
+      inside = And(inside, GreaterEqual(dist, zero));
+    }
+    // padding entries are empty boxes and never set a bit
+    uint32_t mask = MoveMask(inside);
+    while (mask) {
+      visible.push_back(uint32_t(i + Ctz(mask)));
+      mask &= mask - 1;
+    }
+  }
+}
+#else
+void Cull(const BoundsTable& bounds, const Vec4f planes[6],
+          std::vector<uint32_t>& visible) {
+  CullScalar(bounds, planes, visible);
+}
+#endif
+};  // namespace Culling
+};  // namespace Rain
\ No newline at end of file
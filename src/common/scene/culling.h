@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "mathtype.h"
+
+namespace Rain {
+// World space bounds of the objects as structure of arrays, padded to a
+// multiple of Culling::LANES with empty boxes so that the culling pass only
+// runs on whole SIMD registers.
+class BoundsTable {
+ public:
+  std::vector<float> center_[3];  // box center
+  std::vector<float> extent_[3];  // half size, negative for an empty box
+  size_t size_ = 0;
+
+  // every entry empty until set
+  void Resize(size_t n);
+  void Set(size_t i, const Vec3f& bbox_min, const Vec3f& bbox_max);
+  void SetEmpty(size_t i);
+};
+
+struct CullStats {
+  uint32_t n_tested_ = 0;
+  uint32_t n_culled_ = 0;
+  uint32_t n_occluded_ = 0;  // of n_culled_, GPU culling only
+};
+
+namespace Culling {
+// 8 with AVX, 4 with SSE2, 1 otherwise
+extern const uint32_t LANES;
+
+// planes n.x + d >= 0 of the inside, normalized, in the order left, right,
+// bottom, top, near, far, for a Vulkan clip space with z in [0, 1]
+void ExtractPlanes(const Mat4f& proj_view, Vec4f planes[6]);
+// indices of the boxes intersecting the frustum, in increasing order
+void Cull(const BoundsTable& bounds, const Vec4f planes[6],
+          std::vector<uint32_t>& visible);
+// one box at a time, the reference of Cull
+void CullScalar(const BoundsTable& bounds, const Vec4f planes[6],
+                std::vector<uint32_t>& visible);
+};  // namespace Culling
+};  // namespace Rain
\ No newline at end of file
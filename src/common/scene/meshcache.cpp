@@ -0,0 +1,240 @@
+#include "meshcache.h"
+
+#include <spdlog/spdlog.h>
+
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "helper/io.h"
+#include "scene.h"
+
+namespace Rain::MeshCache {
+namespace {
+const char MAGIC[4] = {'R', 'M', 'C', '\0'};
+
+inline uint64_t Align16(uint64_t offset) { return (offset + 15) & ~15ull; }
+
+inline uint64_t Rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+// 4 independent 64-bit lanes, fast enough to be dominated by the file read
+uint64_t HashBytes(const char* data, uint64_t size) {
+  const uint64_t k1 = 0x9E3779B185EBCA87ull;
+  const uint64_t k2 = 0xC2B2AE3D27D4EB4Full;
+  uint64_t h[4] = {size, k1, k2, k1 ^ k2};
+  uint64_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    for (int l = 0; l < 4; ++l) {
+      uint64_t w;
+      memcpy(&w, data + i + 8 * l, 8);
+      h[l] = Rotl(h[l] ^ (w * k2), 31) * k1;
+    }
+  }
+  uint64_t r = Rotl(h[0], 1) + Rotl(h[1], 7) + Rotl(h[2], 12) + Rotl(h[3], 18);
+  for (; i < size; ++i) r = (r ^ uint8_t(data[i])) * 0x100000001B3ull;
+  r ^= r >> 33;
+  r *= k2;
+  r ^= r >> 29;
+  return r;
+}
+
+bool GetSourceKey(const std::string& obj_file, uint64_t& size,
+                  int64_t& mtime) {
+  std::error_code ec;
+  size = std::filesystem::file_size(obj_file, ec);
+  if (ec) return false;
+  auto time = std::filesystem::last_write_time(obj_file, ec);
+  if (ec) return false;
+  mtime = int64_t(time.time_since_epoch().count());
+  return true;
+}
+
+bool HashFile(const std::string& obj_file, uint64_t& hash) {
+  IO::MappedFile file;
+  if (!file.Open(obj_file)) return false;
+  hash = HashBytes(file.data_, file.size_);
+  return true;
+}
+
+bool CheckLayout(const Header& header, uint64_t size) {
+  if (size < sizeof(Header) || memcmp(header.magic_, MAGIC, 4) != 0 ||
+      header.version_ != VERSION || header.file_size_ != size ||
+      header.n_elevert_ != 3)
+    return false;
+  auto in_file = [&](uint64_t offset, uint64_t bytes) {
+    return offset % 16 == 0 && offset <= size && bytes <= size - offset;
+  };
+  return in_file(header.vertices_offset_, header.n_vert_ * sizeof(Vec3f)) &&
+         in_file(header.normals_offset_, header.n_vert_ * sizeof(Vec3f)) &&
+         in_file(header.texcoords_offset_, header.n_texc_ * sizeof(Vec2f)) &&
+         in_file(header.indices_offset_,
+                 header.n_ele_ * header.n_elevert_ * sizeof(uint32_t)) &&
+         in_file(header.materials_offset_,
+                 header.n_material_ * sizeof(MaterialRecord)) &&
+         in_file(header.ranges_offset_, header.n_range_ * sizeof(RangeRecord));
+}
+}  // namespace
+
+std::string GetCacheFile(const std::string& obj_file) {
+  return obj_file + ".rmc";
+}
+
+bool Load(const std::string& obj_file, MeshAsset* obj) {
+  uint64_t source_size;
+  int64_t source_mtime;
+  if (!GetSourceKey(obj_file, source_size, source_mtime)) return false;
+  std::string cache_file = GetCacheFile(obj_file);
+  // copy on write, the object arrays are not const
+  IO::MappedFile file;
+  if (!file.Open(cache_file, true)) return false;
+  const Header* header = reinterpret_cast<const Header*>(file.data_);
+  if (!CheckLayout(*header, file.size_) ||
+      header->source_size_ != source_size) {
+    spdlog::debug("{} is stale", cache_file);
+    return false;
+  }
+  if (header->source_mtime_ != source_mtime) {
+    // touched but maybe not modified, e.g. by a fresh checkout
+    uint64_t source_hash;
+    if (!HashFile(obj_file, source_hash) ||
+        source_hash != header->source_hash_) {
+      spdlog::debug("{} is stale", cache_file);
+      return false;
+    }
+    std::fstream stream(cache_file,
+                        std::ios::in | std::ios::out | std::ios::binary);
+    stream.seekp(offsetof(Header, source_mtime_));
+    stream.write(reinterpret_cast<const char*>(&source_mtime),
+                 sizeof(source_mtime));
+  }
+
+  obj->mapping_size_ = file.size_;
+  char* data = static_cast<char*>(file.Release());
+  obj->mapping_ = data;
+  obj->n_vert_ = header->n_vert_;
+  obj->vertices_ = reinterpret_cast<Vec3f*>(data + header->vertices_offset_);
+  obj->normals_ = reinterpret_cast<Vec3f*>(data + header->normals_offset_);
+  obj->n_texc_ = header->n_texc_;
+  obj->texcoords_ =
+      header->n_texc_
+          ? reinterpret_cast<Vec2f*>(data + header->texcoords_offset_)
+          : nullptr;
+  obj->n_ele_ = header->n_ele_;
+  obj->n_elevert_ = header->n_elevert_;
+  obj->indices_ = reinterpret_cast<uint32_t*>(data + header->indices_offset_);
+  obj->n_surfidx_ = obj->n_ele_ * 3;
+  obj->n_face_ = obj->n_ele_;
+  obj->surface_indices_ = obj->indices_;
+  const MaterialRecord* materials =
+      reinterpret_cast<const MaterialRecord*>(data + header->materials_offset_);
+  obj->materials_.resize(header->n_material_);
+  for (uint32_t i = 0; i < header->n_material_; ++i) {
+    const float* m = materials[i].values_;
+    Material& mat = obj->materials_[i];
+    mat.Ka_ = Vec3f(m[0], m[1], m[2]);
+    mat.Kd_ = Vec3f(m[3], m[4], m[5]);
+    mat.Ks_ = Vec3f(m[6], m[7], m[8]);
+    mat.d_ = m[9];
+    mat.Ns_ = m[10];
+  }
+  const RangeRecord* ranges =
+      reinterpret_cast<const RangeRecord*>(data + header->ranges_offset_);
+  obj->ranges_.resize(header->n_range_);
+  for (uint64_t i = 0; i < header->n_range_; ++i) {
+    obj->ranges_[i] = {ranges[i].first_index_, ranges[i].n_index_,
+                       ranges[i].material_};
+  }
+  obj->bbox_min_ = Vec3f::Map(header->bbox_min_);
+  obj->bbox_max_ = Vec3f::Map(header->bbox_max_);
+  spdlog::debug("{} mapped", cache_file);
+  return true;
+}
+
+bool Save(const std::string& obj_file, const MeshAsset& obj) {
+  if (obj.n_elevert_ != 3) return false;
+  Header header{};
+  memcpy(header.magic_, MAGIC, 4);
+  header.version_ = VERSION;
+  if (!GetSourceKey(obj_file, header.source_size_, header.source_mtime_) ||
+      !HashFile(obj_file, header.source_hash_))
+    return false;
+  header.n_vert_ = obj.n_vert_;
+  header.n_texc_ = obj.n_texc_;
+  header.n_ele_ = obj.n_ele_;
+  header.n_elevert_ = obj.n_elevert_;
+  header.n_material_ = uint32_t(obj.materials_.size());
+  header.n_range_ = obj.ranges_.size();
+  std::vector<MaterialRecord> materials(obj.materials_.size());
+  for (size_t i = 0; i < materials.size(); ++i) {
+    const Material& mat = obj.materials_[i];
+    materials[i] = {{mat.Ka_[0], mat.Ka_[1], mat.Ka_[2], mat.Kd_[0],
+                     mat.Kd_[1], mat.Kd_[2], mat.Ks_[0], mat.Ks_[1],
+                     mat.Ks_[2], mat.d_, mat.Ns_}};
+  }
+  std::vector<RangeRecord> ranges(obj.ranges_.size());
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    ranges[i] = {obj.ranges_[i].first_index_, obj.ranges_[i].n_index_,
+                 obj.ranges_[i].material_, 0};
+  }
+  memcpy(header.bbox_min_, obj.bbox_min_.data(), sizeof(header.bbox_min_));
+  memcpy(header.bbox_max_, obj.bbox_max_.data(), sizeof(header.bbox_max_));
+
+  struct Section {
+    const void* data;
+    uint64_t size;
+    uint64_t* offset;
+  };
+  Section sections[] = {
+      {obj.vertices_, obj.n_vert_ * sizeof(Vec3f), &header.vertices_offset_},
+      {obj.normals_, obj.n_vert_ * sizeof(Vec3f), &header.normals_offset_},
+      {obj.texcoords_, obj.n_texc_ * sizeof(Vec2f), &header.texcoords_offset_},
+      {obj.indices_, obj.n_ele_ * 3 * sizeof(uint32_t),
+       &header.indices_offset_},
+      {materials.data(), materials.size() * sizeof(MaterialRecord),
+       &header.materials_offset_},
+      {ranges.data(), ranges.size() * sizeof(RangeRecord),
+       &header.ranges_offset_}};
+  uint64_t offset = Align16(sizeof(Header));
+  for (auto& section : sections) {
+    *section.offset = offset;
+    offset = Align16(offset + section.size);
+  }
+  header.file_size_ = offset;
+
+  // write aside and rename, so a concurrent reader never sees half a file
+  std::string cache_file = GetCacheFile(obj_file);
+  std::string tmp_file = cache_file + ".tmp";
+  {
+    std::ofstream file(tmp_file, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      spdlog::warn("{} can not be written", tmp_file);
+      return false;
+    }
+    const char zeros[16] = {};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    uint64_t written = sizeof(Header);
+    for (auto& section : sections) {
+      file.write(zeros, *section.offset - written);
+      if (section.size)
+        file.write(static_cast<const char*>(section.data), section.size);
+      written = *section.offset + section.size;
+    }
+    file.write(zeros, header.file_size_ - written);
+    if (!file.good()) {
+      spdlog::warn("{} write failed", tmp_file);
+      return false;
+    }
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmp_file, cache_file, ec);
+  if (ec) {
+    spdlog::warn("{} can not be replaced: {}", cache_file, ec.message());
+    std::filesystem::remove(tmp_file, ec);
+    return false;
+  }
+  spdlog::debug("{} written", cache_file);
+  return true;
+}
+};  // namespace Rain::MeshCache
\ No newline at end of file
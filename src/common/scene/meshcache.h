@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "mathtype.h"
+
+namespace Rain {
+class MeshAsset;
+namespace MeshCache {
+const uint32_t VERSION = 5;
+
+// on-disk layout of <obj>.rmc, arrays follow at 16-byte aligned offsets
+struct Header {
+  char magic_[4];
+  uint32_t version_;
+  uint64_t file_size_;
+  // key of the source obj file
+  uint64_t source_size_;
+  int64_t source_mtime_;
+  uint64_t source_hash_;
+  uint64_t n_vert_;
+  uint64_t n_texc_;
+  uint64_t n_ele_;
+  uint32_t n_elevert_;
+  uint32_t n_material_;
+  uint64_t n_range_;
+  float bbox_min_[3];
+  float bbox_max_[3];
+  uint64_t vertices_offset_;
+  uint64_t normals_offset_;
+  uint64_t texcoords_offset_;
+  uint64_t indices_offset_;
+  uint64_t materials_offset_;
+  uint64_t ranges_offset_;
+};
+
+// Ka, Kd, Ks, d, Ns of one material
+struct MaterialRecord {
+  float values_[11];
+};
+
+struct RangeRecord {
+  uint64_t first_index_;
+  uint64_t n_index_;
+  uint32_t material_;
+  uint32_t pad_;
+};
+
+std::string GetCacheFile(const std::string& obj_file);
+// maps the cache of obj_file into obj if it is still valid for the source
+// file, the arrays then point into the mapping
+bool Load(const std::string& obj_file, MeshAsset* obj);
+bool Save(const std::string& obj_file, const MeshAsset& obj);
+};  // namespace MeshCache
+};  // namespace Rain
\ No newline at end of file
@@ -0,0 +1,475 @@
+#include "objloader.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "helper/io.h"
+#include "helper/parse.h"
+#include "helper/threadpool.h"
+#include "scene.h"
+#include "weld.h"
+
+namespace Rain::ObjLoader {
+namespace {
+using namespace Parse;
+
+enum Record {
+  RECORD_NONE,
+  RECORD_V,
+  RECORD_VN,
+  RECORD_VT,
+  RECORD_F,
+  RECORD_USEMTL,
+  RECORD_MTLLIB
+};
+
+// faces between two usemtl records, they share one material
+struct Segment {
+  std::string_view material_name_;
+  bool inherit_ = true;  // no usemtl yet in this chunk
+  int64_t material_ = -1;
+  size_t n_tri_ = 0;
+  size_t tri_offset_ = 0;
+};
+
+struct Chunk {
+  const char* begin_;
+  const char* end_;
+  size_t n_v_ = 0;
+  size_t n_vn_ = 0;
+  size_t n_vt_ = 0;
+  size_t v_offset_ = 0;
+  size_t vn_offset_ = 0;
+  size_t vt_offset_ = 0;
+  std::vector<Segment> segments_;
+  std::vector<std::string_view> mtllibs_;
+  size_t n_missing_vn_ = 0;  // corners without a normal index
+};
+
+// where ParseChunk writes to, the texcoord and normal indices of the corners
+// are only kept when the file has texcoords or normals
+struct Output {
+  Vec3f* v_ = nullptr;
+  Vec3f* vn_ = nullptr;
+  Vec2f* vt_ = nullptr;
+  size_t n_v_ = 0;
+  size_t n_vn_ = 0;
+  size_t n_vt_ = 0;
+  uint32_t* corner_v_ = nullptr;
+  uint32_t* corner_vt_ = nullptr;
+  uint32_t* corner_vn_ = nullptr;
+};
+
+const size_t MIN_CHUNK_SIZE = 256 * 1024;
+
+// moves p past the record keyword
+inline Record GetRecord(const char*& p, const char* end) {
+  if (end - p < 2) return RECORD_NONE;
+  if (p[0] == 'v') {
+    if (IsSpace(p[1])) {
+      p += 2;
+      return RECORD_V;
+    }
+    if (end - p >= 3 && IsSpace(p[2])) {
+      if (p[1] == 'n') {
+        p += 3;
+        return RECORD_VN;
+      } else if (p[1] == 't') {
+        p += 3;
+        return RECORD_VT;
+      }
+    }
+  } else if (p[0] == 'f' && IsSpace(p[1])) {
+    p += 2;
+    return RECORD_F;
+  } else if (IsKeyword(p, end, "usemtl", 6)) {
+    p += 7;
+    return RECORD_USEMTL;
+  } else if (IsKeyword(p, end, "mtllib", 6)) {
+    p += 7;
+    return RECORD_MTLLIB;
+  }
+  return RECORD_NONE;
+}
+
+void CountChunk(Chunk& chunk) {
+  const char* end = chunk.end_;
+  chunk.segments_.emplace_back();
+  for (const char* p = chunk.begin_; p < end;) {
+    const char* line_end = NextLine(p, end);
+    p = SkipSpace(p, line_end);
+    switch (GetRecord(p, line_end)) {
+      case RECORD_V:
+        ++chunk.n_v_;
+        break;
+      case RECORD_VN:
+        ++chunk.n_vn_;
+        break;
+      case RECORD_VT:
+        ++chunk.n_vt_;
+        break;
+      case RECORD_F: {
+        size_t n = CountTokens(p, line_end);
+        if (n >= 3) chunk.segments_.back().n_tri_ += n - 2;
+        break;
+      }
+      case RECORD_USEMTL: {
+        Segment segment;
+        segment.material_name_ = GetName(p, line_end);
+        segment.inherit_ = false;
+        chunk.segments_.push_back(segment);
+        break;
+      }
+      case RECORD_MTLLIB:
+        chunk.mtllibs_.push_back(GetName(p, line_end));
+        break;
+      default:
+        break;
+    }
+    p = line_end;
+  }
+}
+
+bool ParseChunk(Chunk& chunk, const Output& out) {
+  const char* end = chunk.end_;
+  size_t iv = chunk.v_offset_;
+  size_t ivn = chunk.vn_offset_;
+  size_t ivt = chunk.vt_offset_;
+  size_t segment = 0;
+  size_t itri = chunk.segments_[0].tri_offset_;
+  std::vector<uint32_t> face_v, face_vt, face_vn;
+  for (const char* p = chunk.begin_; p < end;) {
+    const char* line_end = NextLine(p, end);
+    p = SkipSpace(p, line_end);
+    switch (GetRecord(p, line_end)) {
+      case RECORD_V: {
+        float x, y, z;
+        if (!(p = ParseFloat(p, line_end, x)) ||
+            !(p = ParseFloat(p, line_end, y)) ||
+            !(p = ParseFloat(p, line_end, z))) {
+          spdlog::error("malformed obj vertex record");
+          return false;
+        }
+        out.v_[iv++] = Vec3f(x, y, z);
+        break;
+      }
+      case RECORD_VN: {
+        float x, y, z;
+        if (!(p = ParseFloat(p, line_end, x)) ||
+            !(p = ParseFloat(p, line_end, y)) ||
+            !(p = ParseFloat(p, line_end, z))) {
+          spdlog::error("malformed obj normal record");
+          return false;
+        }
+        out.vn_[ivn++] = Vec3f(x, y, z);
+        break;
+      }
+      case RECORD_VT: {
+        float u, v = 0.0f;
+        if (!(p = ParseFloat(p, line_end, u))) {
+          spdlog::error("malformed obj texcoord record");
+          return false;
+        }
+        ParseFloat(p, line_end, v);  // v is optional
+        out.vt_[ivt++] = Vec2f(u, v);
+        break;
+      }
+      case RECORD_F: {
+        face_v.clear();
+        face_vt.clear();
+        face_vn.clear();
+        while (true) {
+          p = SkipSpace(p, line_end);
+          if (p >= line_end || *p == '\n' || *p == '#') break;
+          // v, v/vt, v//vn or v/vt/vn, obj indices are 1-based and negative
+          // ones count back from the records defined so far
+          uint32_t idx[3] = {Weld::NONE, Weld::NONE, Weld::NONE};
+          const size_t defined[3] = {iv, ivt, ivn};
+          const size_t count[3] = {out.n_v_, out.n_vt_, out.n_vn_};
+          for (int k = 0; k < 3; ++k) {
+            if (k > 0) {
+              if (p >= line_end || *p != '/') break;
+              ++p;
+              if (k == 1 && p < line_end && *p == '/') continue;
+            }
+            int64_t i;
+            if (!(p = ParseInt(p, line_end, i)) || i == 0) {
+              spdlog::error("malformed obj face record");
+              return false;
+            }
+            i = i > 0 ? i - 1 : int64_t(defined[k]) + i;
+            if (i < 0 || uint64_t(i) >= count[k]) {
+              spdlog::error("obj face index out of range");
+              return false;
+            }
+            idx[k] = uint32_t(i);
+          }
+          face_v.push_back(idx[0]);
+          face_vt.push_back(idx[1]);
+          face_vn.push_back(idx[2]);
+          if (idx[2] == Weld::NONE) ++chunk.n_missing_vn_;
+          while (p < line_end && !IsSpace(*p) && *p != '\n') ++p;
+        }
+        for (size_t j = 1; j + 1 < face_v.size(); ++j) {
+          const size_t corners[3] = {0, j, j + 1};
+          for (int k = 0; k < 3; ++k) {
+            size_t c = 3 * itri + k;
+            out.corner_v_[c] = face_v[corners[k]];
+            if (out.corner_vt_) out.corner_vt_[c] = face_vt[corners[k]];
+            if (out.corner_vn_) out.corner_vn_[c] = face_vn[corners[k]];
+          }
+          ++itri;
+        }
+        break;
+      }
+      case RECORD_USEMTL:
+        // faces of the next material go to its own range
+        itri = chunk.segments_[++segment].tri_offset_;
+        break;
+      default:
+        break;
+    }
+    p = line_end;
+  }
+  return true;
+}
+
+bool LoadMtl(const std::string& mtl_file, std::vector<Material>& materials,
+             std::unordered_map<std::string, uint32_t>& names) {
+  IO::MappedFile file;
+  if (!file.Open(mtl_file)) {
+    spdlog::warn("failed to read {}", mtl_file);
+    return false;
+  }
+  const char* end = file.end();
+  Material* mat = nullptr;
+  for (const char* p = file.begin(); p < end;) {
+    const char* line_end = NextLine(p, end);
+    p = SkipSpace(p, line_end);
+    auto parse_vec3 = [&](const char* q, Vec3f& out) {
+      float x, y, z;
+      if ((q = ParseFloat(q, line_end, x)) && (q = ParseFloat(q, line_end, y)) &&
+          (q = ParseFloat(q, line_end, z)))
+        out = Vec3f(x, y, z);
+    };
+    if (IsKeyword(p, line_end, "newmtl", 6)) {
+      std::string name(GetName(p + 7, line_end));
+      names[name] = uint32_t(materials.size());
+      materials.emplace_back();
+      mat = &materials.back();
+    } else if (!mat) {
+      // nothing to attach the property to
+    } else if (IsKeyword(p, line_end, "Ka", 2)) {
+      parse_vec3(p + 3, mat->Ka_);
+    } else if (IsKeyword(p, line_end, "Kd", 2)) {
+      parse_vec3(p + 3, mat->Kd_);
+    } else if (IsKeyword(p, line_end, "Ks", 2)) {
+      parse_vec3(p + 3, mat->Ks_);
+    } else if (IsKeyword(p, line_end, "Ns", 2)) {
+      ParseFloat(p + 3, line_end, mat->Ns_);
+    } else if (IsKeyword(p, line_end, "d", 1)) {
+      ParseFloat(p + 2, line_end, mat->d_);
+    } else if (IsKeyword(p, line_end, "Tr", 2)) {
+      float tr;
+      if (ParseFloat(p + 3, line_end, tr)) mat->d_ = 1.0f - tr;
+    }
+    p = line_end;
+  }
+  return true;
+}
+
+// resolves the material of every segment and lays the triangles out so that
+// each material owns one contiguous range of obj->indices_
+size_t AssignRanges(const std::string& obj_file, std::vector<Chunk>& chunks,
+                    MeshAsset* obj) {
+  std::unordered_map<std::string, uint32_t> names;
+  std::filesystem::path dir = std::filesystem::path(obj_file).parent_path();
+  for (auto& chunk : chunks) {
+    for (auto mtllib : chunk.mtllibs_) {
+      LoadMtl((dir / std::string(mtllib)).string(), obj->materials_, names);
+    }
+  }
+
+  int64_t material = -1;
+  bool use_default = false;
+  for (auto& chunk : chunks) {
+    for (auto& segment : chunk.segments_) {
+      if (!segment.inherit_) {
+        auto it = names.find(std::string(segment.material_name_));
+        if (it != names.end()) {
+          material = it->second;
+        } else {
+          spdlog::warn("{}: material {} not found", obj_file,
+                       segment.material_name_);
+          material = -1;
+        }
+      }
+      segment.material_ = material;
+      if (material < 0 && segment.n_tri_) use_default = true;
+    }
+  }
+  if (use_default || obj->materials_.empty()) obj->materials_.emplace_back();
+  uint32_t default_material = uint32_t(obj->materials_.size()) - 1;
+
+  std::vector<size_t> n_tri(obj->materials_.size(), 0);
+  for (auto& chunk : chunks) {
+    for (auto& segment : chunk.segments_) {
+      if (segment.material_ < 0) segment.material_ = default_material;
+      n_tri[segment.material_] += segment.n_tri_;
+    }
+  }
+  std::vector<size_t> cursor(obj->materials_.size(), 0);
+  size_t total = 0;
+  obj->ranges_.clear();
+  for (uint32_t i = 0; i < obj->materials_.size(); ++i) {
+    cursor[i] = total;
+    if (n_tri[i]) obj->ranges_.push_back({3 * total, 3 * n_tri[i], i});
+    total += n_tri[i];
+  }
+  // segments keep their file order inside a range
+  for (auto& chunk : chunks) {
+    for (auto& segment : chunk.segments_) {
+      segment.tri_offset_ = cursor[segment.material_];
+      cursor[segment.material_] += segment.n_tri_;
+    }
+  }
+  return total;
+}
+}  // namespace
+
+bool Load(const std::string& obj_file, MeshAsset* obj) {
+  IO::MappedFile file;
+  if (!file.Open(obj_file)) {
+    spdlog::error("failed to read {}", obj_file);
+    return false;
+  }
+  const char* data = file.begin();
+  const char* end = file.end();
+  ThreadPool& pool = ThreadPool::Global();
+
+  // split at line boundaries, a few chunks per worker for load balance
+  size_t n_chunk = std::min<size_t>(pool.NumWorkers() * 4,
+                                    file.size_ / MIN_CHUNK_SIZE + 1);
+  std::vector<const char*> bounds = SplitLines(data, end, n_chunk);
+  std::vector<Chunk> chunks(n_chunk);
+  for (size_t i = 0; i < n_chunk; ++i) {
+    chunks[i].begin_ = bounds[i];
+    chunks[i].end_ = bounds[i + 1];
+  }
+
+  // pass 1: count records so every chunk knows where its output goes
+  pool.ParallelFor(n_chunk, 1, [&](size_t begin, size_t end, uint32_t) {
+    for (size_t i = begin; i < end; ++i) CountChunk(chunks[i]);
+  });
+  size_t n_v = 0, n_vn = 0, n_vt = 0;
+  for (auto& chunk : chunks) {
+    chunk.v_offset_ = n_v;
+    chunk.vn_offset_ = n_vn;
+    chunk.vt_offset_ = n_vt;
+    n_v += chunk.n_v_;
+    n_vn += chunk.n_vn_;
+    n_vt += chunk.n_vt_;
+  }
+  size_t n_tri = AssignRanges(obj_file, chunks, obj);
+  if (n_v == 0 || n_tri == 0) {
+    spdlog::error("{} has no triangles", obj_file);
+    return false;
+  }
+
+  obj->n_elevert_ = 3;
+  obj->n_ele_ = n_tri;
+  obj->indices_ = new uint32_t[3 * n_tri];
+  size_t n_corner = 3 * n_tri;
+
+  // pass 2: parse, positions and their indices go straight into the object
+  // unless the corners have to be welded first
+  bool weld = n_vn > 0 || n_vt > 0;
+  Output out;
+  out.n_v_ = n_v;
+  out.n_vn_ = n_vn;
+  out.n_vt_ = n_vt;
+  out.v_ = new Vec3f[n_v];
+  std::vector<Vec3f> vn(n_vn);
+  std::vector<Vec2f> vt(n_vt);
+  std::vector<uint32_t> corner_v, corner_vt, corner_vn;
+  out.vn_ = vn.data();
+  out.vt_ = vt.data();
+  if (weld) {
+    corner_v.resize(n_corner);
+    out.corner_v_ = corner_v.data();
+  } else {
+    out.corner_v_ = obj->indices_;
+  }
+  if (n_vt) {
+    corner_vt.resize(n_corner);
+    out.corner_vt_ = corner_vt.data();
+  }
+  if (n_vn) {
+    corner_vn.resize(n_corner);
+    out.corner_vn_ = corner_vn.data();
+  }
+  std::atomic<bool> ok{true};
+  pool.ParallelFor(n_chunk, 1, [&](size_t begin, size_t end, uint32_t) {
+    for (size_t i = begin; i < end; ++i) {
+      if (!ParseChunk(chunks[i], out)) ok = false;
+    }
+  });
+  if (!ok) {
+    spdlog::error("failed to parse {}", obj_file);
+    delete[] out.v_;
+    return false;
+  }
+  if (!weld) {
+    obj->n_vert_ = n_v;
+    obj->vertices_ = out.v_;
+    return true;
+  }
+
+  size_t n_missing_vn = 0;
+  for (auto& chunk : chunks) n_missing_vn += chunk.n_missing_vn_;
+  if (n_vn && n_missing_vn) {
+    spdlog::warn("{}: {} face corners have no normal, normals ignored",
+                 obj_file, n_missing_vn);
+    corner_vn.clear();
+  }
+
+  // one vertex per distinct (v, vt, vn) triplet
+  std::vector<uint32_t> first;
+  uint32_t n_vert = Weld::Build(
+      n_corner, corner_v.data(), corner_vt.empty() ? nullptr : corner_vt.data(),
+      corner_vn.empty() ? nullptr : corner_vn.data(), obj->indices_, first);
+  obj->n_vert_ = n_vert;
+  obj->vertices_ = new Vec3f[n_vert];
+  if (!corner_vn.empty()) obj->normals_ = new Vec3f[n_vert];
+  if (!corner_vt.empty()) {
+    obj->n_texc_ = n_vert;
+    obj->texcoords_ = new Vec2f[n_vert];
+  }
+  pool.ParallelFor(n_vert, 4096, [&](size_t begin, size_t end, uint32_t) {
+    for (size_t i = begin; i < end; ++i) {
+      uint32_t c = first[i];
+      obj->vertices_[i] = out.v_[corner_v[c]];
+      if (obj->normals_) obj->normals_[i] = vn[corner_vn[c]];
+      if (obj->texcoords_) {
+        obj->texcoords_[i] =
+            corner_vt[c] == Weld::NONE ? Vec2f::Zero() : vt[corner_vt[c]];
+      }
+    }
+  });
+  delete[] out.v_;
+  spdlog::info(
+      "{}: {} corners welded to {} vertices, {:.2f} corners per vertex, "
+      "{:.2f} vertices per position",
+      obj_file, n_corner, n_vert, double(n_corner) / n_vert,
+      double(n_vert) / n_v);
+  return true;
+}
+};  // namespace Rain::ObjLoader
\ No newline at end of file
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+namespace Rain {
+class MeshAsset;
+namespace ObjLoader {
+// Parse v/vn/vt/f records of an obj file on all cores, straight into the
+// arrays of obj. Polygons are triangulated as fans, like tinyobj does.
+// Every shape ends up in the same arrays, faces are grouped by their
+// usemtl material into obj->ranges_ and mtllib files fill obj->materials_.
+// When the file has normals or texcoords, every distinct v/vt/vn triplet of
+// the faces becomes one vertex.
+bool Load(const std::string& obj_file, MeshAsset* obj);
+};  // namespace ObjLoader
+};  // namespace Rain
\ No newline at end of file
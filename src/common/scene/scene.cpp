@@ -1,67 +1,44 @@
 #include "scene.h"
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "tiny_obj_loader.h"
+#include <algorithm>
+#include <vector>
 
-namespace Rain {
-bool Object::Init(const std::string& obj_file, const Mat3f& rot,
-                  const Vec3f& trans, float scale) {
-  transformation_ = Mat4f::Identity();
-  transformation_.block<3, 3>(0, 0) = scale * rot;
-  transformation_.block<3, 1>(0, 3) = trans;
+#include "helper/io.h"
+#include "helper/threadpool.h"
+#include "meshcache.h"
+#include "normals.h"
+#include "objloader.h"
+#include "reorder.h"
+#include "sceneloader.h"
 
-  tinyobj::attrib_t attrib;
-  std::vector<tinyobj::shape_t> shapes;
-  std::vector<tinyobj::material_t> materials;
-  std::string warn;
-  std::string err;
-
-  bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err,
-                              obj_file.c_str());
-  if (!warn.empty()) spdlog::warn(warn);
-  if (!err.empty()) spdlog::error(err);
-  if (!ret) return ret;
-  if (shapes.size() != 1) {
-    spdlog::error("multiple shapes in one model");
-    return false;
-  }
-  tinyobj::mesh_t& mesh = shapes[0].mesh;
-  n_vert_ = attrib.vertices.size() / 3;
-  vertices_ = new Vec3f[n_vert_];
-  for (size_t i = 0; i < n_vert_; ++i) {
-    vertices_[i] = Vec3f(attrib.vertices[3 * i], attrib.vertices[3 * i + 1],
-                         attrib.vertices[3 * i + 2]);
-    vertices_[i] = scale * rot * vertices_[i] + trans;
-  }
-  if (attrib.normals.size() > 0) {
-    assert(attrib.normals.size() == n_vert_);
-    normals_ = new Vec3f[n_vert_];
-    for (size_t i = 0; i < n_vert_; ++i) {
-      normals_[i] = Vec3f(attrib.normals[3 * i], attrib.normals[3 * i + 1],
-                          attrib.normals[3 * i + 2]);
-      normals_[i] = rot * normals_[i];
-    }
-  }
-  if (attrib.texcoords.size() > 0) {
-    n_texc_ = attrib.texcoords.size() / 2;
-    texcoords_ = new Vec2f[n_texc_];
-    for (size_t i = 0; i < n_texc_; ++i) {
-      texcoords_[i] =
-          Vec2f(attrib.texcoords[2 * i], attrib.texcoords[2 * i + 1]);
-    }
-  }
-  n_elevert_ = mesh.num_face_vertices[0];
-  n_ele_ = mesh.indices.size() / n_elevert_;
-  indices_ = new uint32_t[mesh.indices.size()];
-  size_t index_offset = 0;
-  for (size_t f = 0; f < mesh.num_face_vertices.size(); ++f) {
-    assert(mesh.num_face_vertices[f] == n_elevert_);
-    for (size_t v = 0; v < n_elevert_; ++v) {
-      tinyobj::index_t& idx = mesh.indices[index_offset + v];
-      indices_[index_offset + v] = idx.vertex_index;
-    }
-    index_offset += n_elevert_;
+namespace Rain {
+namespace {
+// reorders one draw range in the index space of the vertices it references,
+// so the optimizer's per-vertex arrays do not scale with the whole mesh
+void OptimizeRangeCache(uint32_t* indices, size_t n_index) {
+  std::vector<uint32_t> verts(indices, indices + n_index);
+  std::sort(verts.begin(), verts.end());
+  verts.erase(std::unique(verts.begin(), verts.end()), verts.end());
+  std::vector<uint32_t> local(n_index);
+  for (size_t i = 0; i < n_index; ++i) {
+    local[i] = uint32_t(
+        std::lower_bound(verts.begin(), verts.end(), indices[i]) -
+        verts.begin());
   }
+  Reorder::OptimizeCache(local.data(), n_index, verts.size());
+  for (size_t i = 0; i < n_index; ++i) indices[i] = verts[local[i]];
+}
+}  // namespace
+
+MeshAsset::~MeshAsset() {
+  if (load_.valid()) load_.wait();
+  Destroy();
+}
+
+bool MeshAsset::Init(const std::string& obj_file) {
+  if (MeshCache::Load(obj_file, this)) return true;
+  if (!ObjLoader::Load(obj_file, this)) return false;
+  bool has_normals = normals_ != nullptr;
   if (n_elevert_ == 3) {
     n_surfidx_ = n_ele_ * 3;
     n_face_ = n_ele_;
@@ -70,47 +47,117 @@ bool Object::Init(const std::string& obj_file, const Mat3f& rot,
     // TODO: build surface indices from tetmesh
   }
 
-  if (attrib.normals.size() == 0) {
+  if (!has_normals) {
     // compute surface normal
     normals_ = new Vec3f[n_vert_];
-    memset(normals_, 0, n_vert_ * sizeof(Vec3f));
-    for (size_t f = 0; f < n_face_; ++f) {
-      uint32_t v1 = surface_indices_[3 * f];
-      uint32_t v2 = surface_indices_[3 * f + 1];
-      uint32_t v3 = surface_indices_[3 * f + 2];
-      Vec3f dx1 = vertices_[v2] - vertices_[v1];
-      Vec3f dx2 = vertices_[v3] - vertices_[v1];
-      Vec3f normal = (dx1.cross(dx2)).normalized();
-      normals_[v1] += normal;
-      normals_[v2] += normal;
-      normals_[v3] += normal;
-    }
-    for (size_t i = 0; i < n_vert_; ++i) {
-      normals_[i] = normals_[i].normalized();
-    }
+    NormalSolver solver;
+    solver.Init(n_vert_, n_face_, surface_indices_);
+    solver.Compute(vertices_, normals_);
+  }
+
+  if (n_elevert_ == 3) {
+    // triangles only move within their draw range, the vertices are shared
+    Reorder::CacheStats before =
+        Reorder::Analyze(surface_indices_, n_surfidx_, n_vert_);
+    ThreadPool::Global().ParallelFor(
+        ranges_.size(), 1, [&](size_t begin, size_t end, uint32_t) {
+          for (size_t i = begin; i < end; ++i) {
+            OptimizeRangeCache(surface_indices_ + ranges_[i].first_index_,
+                               ranges_[i].n_index_);
+          }
+        });
+    Reorder::OptimizeFetch(surface_indices_, n_surfidx_, n_vert_, vertices_,
+                           normals_,
+                           n_texc_ == n_vert_ ? texcoords_ : nullptr);
+    Reorder::CacheStats after =
+        Reorder::Analyze(surface_indices_, n_surfidx_, n_vert_);
+    spdlog::info("{}: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}", obj_file,
+                 before.acmr_, after.acmr_, before.atvr_, after.atvr_);
+  }
+
+  bbox_min_ = bbox_max_ = vertices_[0];
+  for (size_t i = 1; i < n_vert_; ++i) {
+    bbox_min_ = bbox_min_.cwiseMin(vertices_[i]);
+    bbox_max_ = bbox_max_.cwiseMax(vertices_[i]);
   }
 
+  MeshCache::Save(obj_file, *this);
   return true;
 }
 
-void Object::Destroy() {
-  if (vertices_) delete[] vertices_;
-  if (normals_) delete[] normals_;
-  if (texcoords_) delete[] texcoords_;
-  if (indices_) delete[] indices_;
-  if ((n_elevert_ == 4) && surface_indices_) delete[] surface_indices_;
+bool MeshAsset::IsLoaded() {
+  if (load_state_ == LOAD_PENDING && load_.valid() &&
+      load_.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+    load_state_ = load_.get() ? LOAD_DONE : LOAD_FAILED;
+  }
+  return load_state_ == LOAD_DONE;
+}
+
+void MeshAsset::Destroy() {
+  if (mapping_) {
+    IO::MappedFile::Unmap(mapping_, mapping_size_);
+  } else {
+    if (vertices_) delete[] vertices_;
+    if (normals_) delete[] normals_;
+    if (texcoords_) delete[] texcoords_;
+    if (indices_) delete[] indices_;
+    if ((n_elevert_ == 4) && surface_indices_) delete[] surface_indices_;
+  }
+  mapping_ = nullptr;
+  vertices_ = nullptr;
+  normals_ = nullptr;
+  texcoords_ = nullptr;
+  indices_ = nullptr;
+  surface_indices_ = nullptr;
+}
+
+MeshHandle MeshRegistry::Acquire(const std::string& obj_file) {
+  MeshHandle mesh = assets_[obj_file].lock();
+  if (mesh) return mesh;
+  mesh = std::make_shared<MeshAsset>();
+  MeshAsset* asset = mesh.get();
+  asset->load_ = std::async(std::launch::async,
+                            [=] { return asset->Init(obj_file); });
+  assets_[obj_file] = mesh;
+  return mesh;
+}
+
+void MeshRegistry::Clear() { assets_.clear(); }
+
+void Object::Init(const MeshHandle& mesh, const Mat3f& rot, const Vec3f& trans,
+                  float scale) {
+  mesh_ = mesh;
+  transformation_ = Mat4f::Identity();
+  transformation_.block<3, 3>(0, 0) = scale * rot;
+  transformation_.block<3, 1>(0, 3) = trans;
+}
+
+void Object::UpdateBounds() {
+  Vec3f center = 0.5f * (mesh_->bbox_min_ + mesh_->bbox_max_);
+  Vec3f extent = 0.5f * (mesh_->bbox_max_ - mesh_->bbox_min_);
+  Mat3f linear = transformation_.block<3, 3>(0, 0);
+  // the box around the transformed box
+  center_ = linear * center + transformation_.block<3, 1>(0, 3);
+  Vec3f world_extent = linear.cwiseAbs() * extent;
+  bbox_min_ = center_ - world_extent;
+  bbox_max_ = center_ + world_extent;
 }
 
-void Scene::Init() {
-  Object bunny;
-  bunny.Init("../assets/bunny/bunny.obj", Mat3f::Identity(), Vec3f::Zero(),
-             5.0f);
-  objects_.push_back(bunny);
+bool Scene::Init(const std::string& scene_file) {
+  return SceneLoader::Load(scene_file, this);
 }
 
+void Scene::AddObject(const std::string& obj_file, const Mat3f& rot,
+                      const Vec3f& trans, float scale) {
+  objects_.emplace_back();
+  objects_.back().Init(meshes_.Acquire(obj_file), rot, trans, scale);
+}
+
+bool Scene::IsLoaded(size_t index) { return objects_[index].mesh_->IsLoaded(); }
+
 void Scene::Destroy() {
-  for (Object obj : objects_) {
-    obj.Destroy();
-  }
+  // the last handle waits for a pending load and frees the geometry
+  objects_.clear();
+  meshes_.Clear();
 }
 };  // namespace Rain
\ No newline at end of file
@@ -2,7 +2,10 @@
 
 #include <spdlog/spdlog.h>
 
+#include <future>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "mathtype.h"
@@ -16,8 +19,20 @@ struct Material {
   float Ns_ = 0.0f;                     // shininess
 };
 
-class Object {
+// contiguous part of the surface indices drawn with one material
+struct DrawRange {
+  uint64_t first_index_;
+  uint64_t n_index_;
+  uint32_t material_;
+};
+
+// Geometry of one obj file in object space, shared by every Object placed
+// from it. Instances hold it through a MeshHandle and it is freed with the
+// last of them.
+class MeshAsset {
  public:
+  enum LoadState { LOAD_PENDING, LOAD_DONE, LOAD_FAILED };
+
   uint64_t n_vert_ = 0;
   Vec3f* vertices_ = nullptr;
   Vec3f* normals_ = nullptr;
@@ -29,18 +44,72 @@ class Object {
   uint64_t n_surfidx_;
   uint64_t n_face_;
   uint32_t* surface_indices_ = nullptr;
+  std::vector<Material> materials_;
+  std::vector<DrawRange> ranges_;  // one per used material
+  Vec3f bbox_min_;
+  Vec3f bbox_max_;
+  // set when the arrays live in a mapped mesh cache instead of the heap
+  void* mapping_ = nullptr;
+  uint64_t mapping_size_ = 0;
+  std::future<bool> load_;
+  LoadState load_state_ = LOAD_PENDING;
+
+  MeshAsset() = default;
+  MeshAsset(const MeshAsset&) = delete;
+  MeshAsset& operator=(const MeshAsset&) = delete;
+  ~MeshAsset();
+  bool Init(const std::string& obj_file);
+  // non-blocking, true once the geometry is parsed and ready for upload
+  bool IsLoaded();
+  void Destroy();
+};
+
+using MeshHandle = std::shared_ptr<MeshAsset>;
+
+// one MeshAsset per obj file for as long as any instance holds it
+class MeshRegistry {
+ public:
+  std::unordered_map<std::string, std::weak_ptr<MeshAsset>> assets_;
+
+  // the asset of obj_file, loading starts on a worker thread if it is new
+  MeshHandle Acquire(const std::string& obj_file);
+  void Clear();
+};
+
+// one placement of a mesh
+class Object {
+ public:
+  MeshHandle mesh_;
+  Mat4f transformation_ = Mat4f::Identity();
+  // replaces the materials of the mesh when set
+  bool override_material_ = false;
   Material material_;
-  Mat4f transformation_;
+  // world space bounds, valid once the mesh is loaded
+  Vec3f bbox_min_ = Vec3f::Zero();
+  Vec3f bbox_max_ = Vec3f::Zero();
+  Vec3f center_ = Vec3f::Zero();
 
-  bool Init(const std::string& obj_file, const Mat3f& rot, const Vec3f& trans,
+  void Init(const MeshHandle& mesh, const Mat3f& rot, const Vec3f& trans,
             float scale);
-  void Destroy();
+  // from the box of the mesh and transformation_
+  void UpdateBounds();
+  const Material& GetMaterial(const DrawRange& range) const {
+    return override_material_ ? material_ : mesh_->materials_[range.material_];
+  }
 };
 
 class Scene {
  public:
+  MeshRegistry meshes_;
   std::vector<Object> objects_;
-  void Init();
+
+  // parses scene_file and starts loading its meshes on worker threads,
+  // returns once the objects are placed
+  bool Init(const std::string& scene_file);
+  void AddObject(const std::string& obj_file, const Mat3f& rot,
+                 const Vec3f& trans, float scale);
+  // non-blocking, true once the mesh of the object is ready for upload
+  bool IsLoaded(size_t index);
   void Destroy();
 };
 };  // namespace Rain
\ No newline at end of file
@@ -0,0 +1,457 @@
+#include "sceneloader.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "helper/io.h"
+#include "helper/parse.h"
+#include "helper/threadpool.h"
+#include "scene.h"
+
+namespace Rain::SceneLoader {
+namespace {
+using namespace Parse;
+
+const char MAGIC[4] = {'R', 'S', 'C', '\0'};
+const size_t MIN_CHUNK_SIZE = 64 * 1024;
+const size_t GRAIN = 4096;
+
+struct MeshDecl {
+  std::string_view name_;
+  std::string_view path_;
+};
+
+struct MaterialDecl {
+  std::string_view name_;
+  Material material_;
+};
+
+struct ObjectDecl {
+  std::string_view mesh_;
+  std::string_view material_;  // empty for the materials of the mesh
+  Mat4f transformation_;
+};
+
+struct Chunk {
+  const char* begin_;
+  const char* end_;
+  std::vector<MeshDecl> meshes_;
+  std::vector<MaterialDecl> materials_;
+  std::vector<ObjectDecl> objects_;
+  size_t object_offset_ = 0;
+};
+
+inline uint64_t Align16(uint64_t offset) { return (offset + 15) & ~15ull; }
+
+inline const char* ParseVec3(const char* p, const char* end, Vec3f& out) {
+  float x, y, z;
+  if ((p = ParseFloat(p, end, x)) && (p = ParseFloat(p, end, y)) &&
+      (p = ParseFloat(p, end, z)))
+    out = Vec3f(x, y, z);
+  return p;
+}
+
+Mat4f GetTransformation(const Vec3f& trans, const Vec3f& degrees,
+                        float scale) {
+  Vec3f rad = degrees * float(EIGEN_PI / 180.0);
+  Mat3f rot = (Eigen::AngleAxisf(rad[2], Vec3f::UnitZ()) *
+               Eigen::AngleAxisf(rad[1], Vec3f::UnitY()) *
+               Eigen::AngleAxisf(rad[0], Vec3f::UnitX()))
+                  .toRotationMatrix();
+  Mat4f transformation = Mat4f::Identity();
+  transformation.block<3, 3>(0, 0) = scale * rot;
+  transformation.block<3, 1>(0, 3) = trans;
+  return transformation;
+}
+
+bool ParseMaterial(const char* p, const char* end, Material& mat) {
+  std::string_view key;
+  while ((p = ParseToken(p, end, key))) {
+    if (key == "Ka") {
+      p = ParseVec3(p, end, mat.Ka_);
+    } else if (key == "Kd") {
+      p = ParseVec3(p, end, mat.Kd_);
+    } else if (key == "Ks") {
+      p = ParseVec3(p, end, mat.Ks_);
+    } else if (key == "Ns") {
+      p = ParseFloat(p, end, mat.Ns_);
+    } else if (key == "d") {
+      p = ParseFloat(p, end, mat.d_);
+    } else {
+      return false;
+    }
+    if (!p) return false;
+  }
+  return true;
+}
+
+bool ParseChunk(Chunk& chunk) {
+  const char* end = chunk.end_;
+  for (const char* p = chunk.begin_; p < end;) {
+    const char* line_end = NextLine(p, end);
+    std::string_view record;
+    const char* q = ParseToken(p, line_end, record);
+    bool ok = true;
+    if (!q) {
+      // empty or comment
+    } else if (record == "object") {
+      ObjectDecl object;
+      Vec3f trans, degrees;
+      float scale;
+      ok = (q = ParseToken(q, line_end, object.mesh_)) &&
+           (q = ParseVec3(q, line_end, trans)) &&
+           (q = ParseVec3(q, line_end, degrees)) &&
+           (q = ParseFloat(q, line_end, scale));
+      if (ok) {
+        if (!ParseToken(q, line_end, object.material_))
+          object.material_ = std::string_view();
+        object.transformation_ = GetTransformation(trans, degrees, scale);
+        chunk.objects_.push_back(object);
+      }
+    } else if (record == "mesh") {
+      MeshDecl mesh;
+      ok = (q = ParseToken(q, line_end, mesh.name_));
+      if (ok) {
+        mesh.path_ = GetName(q, line_end);
+        ok = !mesh.path_.empty();
+        chunk.meshes_.push_back(mesh);
+      }
+    } else if (record == "material") {
+      MaterialDecl material;
+      ok = (q = ParseToken(q, line_end, material.name_)) &&
+           ParseMaterial(q, line_end, material.material_);
+      if (ok) chunk.materials_.push_back(material);
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      spdlog::error("malformed scene record: {}", GetName(p, line_end));
+      return false;
+    }
+    p = line_end;
+  }
+  return true;
+}
+
+std::string GetMeshFile(const std::filesystem::path& dir,
+                        std::string_view path) {
+  return (dir / std::string(path)).lexically_normal().string();
+}
+
+bool LoadText(const std::string& scene_file, const IO::MappedFile& file,
+              Scene* scene) {
+  const char* data = file.begin();
+  const char* end = file.end();
+  ThreadPool& pool = ThreadPool::Global();
+
+  size_t n_chunk = std::min<size_t>(pool.NumWorkers() * 4,
+                                    file.size_ / MIN_CHUNK_SIZE + 1);
+  std::vector<const char*> bounds = SplitLines(data, end, n_chunk);
+  std::vector<Chunk> chunks(n_chunk);
+  for (size_t i = 0; i < n_chunk; ++i) {
+    chunks[i].begin_ = bounds[i];
+    chunks[i].end_ = bounds[i + 1];
+  }
+  std::atomic<bool> ok{true};
+  pool.ParallelFor(n_chunk, 1, [&](size_t begin, size_t end, uint32_t) {
+    for (size_t i = begin; i < end; ++i) {
+      if (!ParseChunk(chunks[i])) ok = false;
+    }
+  });
+  if (!ok) return false;
+
+  // declarations are few, resolve them in file order
+  std::unordered_map<std::string_view, uint32_t> mesh_ids, material_ids;
+  std::vector<std::string_view> mesh_paths;
+  std::vector<Material> materials;
+  size_t n_object = 0;
+  for (auto& chunk : chunks) {
+    for (auto& mesh : chunk.meshes_) {
+      auto it = mesh_ids.emplace(mesh.name_, uint32_t(mesh_paths.size()));
+      if (it.second) {
+        mesh_paths.push_back(mesh.path_);
+      } else {
+        spdlog::warn("{}: mesh {} redeclared", scene_file, mesh.name_);
+        mesh_paths[it.first->second] = mesh.path_;
+      }
+    }
+    for (auto& material : chunk.materials_) {
+      auto it = material_ids.emplace(material.name_,
+                                     uint32_t(materials.size()));
+      if (it.second) {
+        materials.push_back(material.material_);
+      } else {
+        spdlog::warn("{}: material {} redeclared", scene_file, material.name_);
+        materials[it.first->second] = material.material_;
+      }
+    }
+    chunk.object_offset_ = n_object;
+    n_object += chunk.objects_.size();
+  }
+
+  std::vector<uint32_t> object_meshes(n_object);
+  std::vector<int32_t> object_materials(n_object);
+  pool.ParallelFor(n_chunk, 1, [&](size_t begin, size_t end, uint32_t) {
+    for (size_t i = begin; i < end; ++i) {
+      const Chunk& chunk = chunks[i];
+      for (size_t j = 0; j < chunk.objects_.size(); ++j) {
+        const ObjectDecl& object = chunk.objects_[j];
+        size_t index = chunk.object_offset_ + j;
+        auto mesh = mesh_ids.find(object.mesh_);
+        if (mesh == mesh_ids.end()) {
+          spdlog::error("{}: mesh {} not declared", scene_file, object.mesh_);
+          ok = false;
+          return;
+        }
+        object_meshes[index] = mesh->second;
+        object_materials[index] = -1;
+        if (object.material_.empty()) continue;
+        auto material = material_ids.find(object.material_);
+        if (material == material_ids.end()) {
+          spdlog::warn("{}: material {} not declared", scene_file,
+                       object.material_);
+        } else {
+          object_materials[index] = int32_t(material->second);
+        }
+      }
+    }
+  });
+  if (!ok) return false;
+
+  // only meshes that are placed get loaded
+  std::vector<uint8_t> used(mesh_paths.size(), 0);
+  for (uint32_t mesh : object_meshes) used[mesh] = 1;
+  std::filesystem::path dir = std::filesystem::path(scene_file).parent_path();
+  std::vector<MeshHandle> meshes(mesh_paths.size());
+  for (size_t i = 0; i < mesh_paths.size(); ++i) {
+    if (!used[i]) continue;
+    meshes[i] = scene->meshes_.Acquire(GetMeshFile(dir, mesh_paths[i]));
+  }
+
+  size_t base = scene->objects_.size();
+  scene->objects_.resize(base + n_object);
+  pool.ParallelFor(n_chunk, 1, [&](size_t begin, size_t end, uint32_t) {
+    for (size_t i = begin; i < end; ++i) {
+      const Chunk& chunk = chunks[i];
+      for (size_t j = 0; j < chunk.objects_.size(); ++j) {
+        size_t index = chunk.object_offset_ + j;
+        Object& obj = scene->objects_[base + index];
+        obj.mesh_ = meshes[object_meshes[index]];
+        obj.transformation_ = chunk.objects_[j].transformation_;
+        obj.override_material_ = object_materials[index] >= 0;
+        if (obj.override_material_)
+          obj.material_ = materials[object_materials[index]];
+      }
+    }
+  });
+  spdlog::info("{}: {} objects of {} meshes", scene_file, n_object,
+               std::count(used.begin(), used.end(), 1));
+  return true;
+}
+
+bool LoadBinary(const std::string& scene_file, const IO::MappedFile& file,
+                Scene* scene) {
+  const BinaryHeader* header =
+      reinterpret_cast<const BinaryHeader*>(file.data_);
+  auto in_file = [&](uint64_t offset, uint64_t bytes) {
+    return offset % 16 == 0 && offset <= file.size_ &&
+           bytes <= file.size_ - offset;
+  };
+  if (file.size_ < sizeof(BinaryHeader) || header->version_ != VERSION ||
+      header->file_size_ != file.size_ ||
+      !in_file(header->meshes_offset_,
+               header->n_mesh_ * sizeof(MeshRecord)) ||
+      !in_file(header->materials_offset_,
+               header->n_material_ * sizeof(MaterialRecord)) ||
+      !in_file(header->objects_offset_,
+               header->n_object_ * sizeof(ObjectRecord)) ||
+      !in_file(header->strings_offset_, 0)) {
+    spdlog::error("{} is not a valid binary scene", scene_file);
+    return false;
+  }
+  const MeshRecord* mesh_records =
+      reinterpret_cast<const MeshRecord*>(file.data_ + header->meshes_offset_);
+  const MaterialRecord* material_records =
+      reinterpret_cast<const MaterialRecord*>(file.data_ +
+                                              header->materials_offset_);
+  const ObjectRecord* object_records = reinterpret_cast<const ObjectRecord*>(
+      file.data_ + header->objects_offset_);
+  const char* strings = file.data_ + header->strings_offset_;
+  uint64_t strings_size = file.size_ - header->strings_offset_;
+
+  std::filesystem::path dir = std::filesystem::path(scene_file).parent_path();
+  std::vector<MeshHandle> meshes(header->n_mesh_);
+  for (uint32_t i = 0; i < header->n_mesh_; ++i) {
+    const MeshRecord& record = mesh_records[i];
+    if (record.path_offset_ > strings_size ||
+        record.path_size_ > strings_size - record.path_offset_) {
+      spdlog::error("{} is not a valid binary scene", scene_file);
+      return false;
+    }
+    std::string_view path(strings + record.path_offset_, record.path_size_);
+    meshes[i] = scene->meshes_.Acquire(GetMeshFile(dir, path));
+  }
+  std::vector<Material> materials(header->n_material_);
+  for (uint32_t i = 0; i < header->n_material_; ++i) {
+    const float* m = material_records[i].values_;
+    Material& mat = materials[i];
+    mat.Ka_ = Vec3f(m[0], m[1], m[2]);
+    mat.Kd_ = Vec3f(m[3], m[4], m[5]);
+    mat.Ks_ = Vec3f(m[6], m[7], m[8]);
+    mat.d_ = m[9];
+    mat.Ns_ = m[10];
+  }
+
+  size_t base = scene->objects_.size();
+  scene->objects_.resize(base + header->n_object_);
+  std::atomic<bool> ok{true};
+  ThreadPool::Global().ParallelFor(
+      header->n_object_, GRAIN, [&](size_t begin, size_t end, uint32_t) {
+        for (size_t i = begin; i < end; ++i) {
+          const ObjectRecord& record = object_records[i];
+          if (record.mesh_ >= header->n_mesh_ ||
+              record.material_ >= int32_t(header->n_material_)) {
+            ok = false;
+            return;
+          }
+          Object& obj = scene->objects_[base + i];
+          obj.mesh_ = meshes[record.mesh_];
+          obj.transformation_ = Mat4f::Identity();
+          obj.transformation_.block<3, 4>(0, 0) =
+              Eigen::Map<const Eigen::Matrix<float, 3, 4>>(
+                  record.transformation_);
+          obj.override_material_ = record.material_ >= 0;
+          if (obj.override_material_)
+            obj.material_ = materials[record.material_];
+        }
+      });
+  if (!ok) {
+    spdlog::error("{} has objects out of range", scene_file);
+    scene->objects_.resize(base);
+    return false;
+  }
+  spdlog::info("{}: {} objects of {} meshes", scene_file, header->n_object_,
+               header->n_mesh_);
+  return true;
+}
+}  // namespace
+
+bool Load(const std::string& scene_file, Scene* scene) {
+  IO::MappedFile file;
+  if (!file.Open(scene_file)) {
+    spdlog::error("failed to read {}", scene_file);
+    return false;
+  }
+  if (file.size_ >= 4 && memcmp(file.data_, MAGIC, 4) == 0)
+    return LoadBinary(scene_file, file, scene);
+  return LoadText(scene_file, file, scene);
+}
+
+bool SaveBinary(const std::string& scene_file, const Scene& scene) {
+  std::filesystem::path dir = std::filesystem::path(scene_file).parent_path();
+  std::unordered_map<const MeshAsset*, uint32_t> mesh_ids;
+  std::vector<MeshRecord> mesh_records;
+  std::string strings;
+  // the registry knows the file of every live mesh
+  for (auto& asset : scene.meshes_.assets_) {
+    MeshHandle mesh = asset.second.lock();
+    if (!mesh) continue;
+    std::error_code ec;
+    std::filesystem::path path =
+        std::filesystem::relative(asset.first, dir.empty() ? "." : dir, ec);
+    if (ec || path.empty()) path = std::filesystem::absolute(asset.first);
+    std::string path_string = path.generic_string();
+    mesh_ids[mesh.get()] = uint32_t(mesh_records.size());
+    mesh_records.push_back({strings.size(), path_string.size()});
+    strings += path_string;
+  }
+
+  std::map<std::array<float, 11>, int32_t> material_ids;
+  std::vector<MaterialRecord> material_records;
+  std::vector<ObjectRecord> object_records(scene.objects_.size());
+  for (size_t i = 0; i < scene.objects_.size(); ++i) {
+    const Object& obj = scene.objects_[i];
+    ObjectRecord& record = object_records[i];
+    auto mesh = mesh_ids.find(obj.mesh_.get());
+    if (mesh == mesh_ids.end()) {
+      spdlog::error("{}: object {} has no registered mesh", scene_file, i);
+      return false;
+    }
+    record.mesh_ = mesh->second;
+    Eigen::Map<Eigen::Matrix<float, 3, 4>>(record.transformation_) =
+        obj.transformation_.block<3, 4>(0, 0);
+    record.material_ = -1;
+    if (obj.override_material_) {
+      const Material& mat = obj.material_;
+      std::array<float, 11> values = {
+          mat.Ka_[0], mat.Ka_[1], mat.Ka_[2], mat.Kd_[0], mat.Kd_[1],
+          mat.Kd_[2], mat.Ks_[0], mat.Ks_[1], mat.Ks_[2], mat.d_, mat.Ns_};
+      auto it = material_ids.emplace(values,
+                                     int32_t(material_records.size()));
+      if (it.second) {
+        material_records.emplace_back();
+        std::copy(values.begin(), values.end(),
+                  material_records.back().values_);
+      }
+      record.material_ = it.first->second;
+    }
+  }
+
+  BinaryHeader header{};
+  memcpy(header.magic_, MAGIC, 4);
+  header.version_ = VERSION;
+  header.n_mesh_ = uint32_t(mesh_records.size());
+  header.n_material_ = uint32_t(material_records.size());
+  header.n_object_ = object_records.size();
+  struct Section {
+    const void* data;
+    uint64_t size;
+    uint64_t* offset;
+  };
+  Section sections[] = {
+      {mesh_records.data(), mesh_records.size() * sizeof(MeshRecord),
+       &header.meshes_offset_},
+      {material_records.data(),
+       material_records.size() * sizeof(MaterialRecord),
+       &header.materials_offset_},
+      {object_records.data(), object_records.size() * sizeof(ObjectRecord),
+       &header.objects_offset_},
+      {strings.data(), strings.size(), &header.strings_offset_}};
+  uint64_t offset = Align16(sizeof(BinaryHeader));
+  for (auto& section : sections) {
+    *section.offset = offset;
+    offset = Align16(offset + section.size);
+  }
+  header.file_size_ = offset;
+
+  std::ofstream file(scene_file, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    spdlog::error("{} can not be written", scene_file);
+    return false;
+  }
+  const char zeros[16] = {};
+  file.write(reinterpret_cast<const char*>(&header), sizeof(BinaryHeader));
+  uint64_t written = sizeof(BinaryHeader);
+  for (auto& section : sections) {
+    file.write(zeros, *section.offset - written);
+    if (section.size)
+      file.write(static_cast<const char*>(section.data), section.size);
+    written = *section.offset + section.size;
+  }
+  file.write(zeros, header.file_size_ - written);
+  if (!file.good()) {
+    spdlog::error("{} write failed", scene_file);
+    return false;
+  }
+  return true;
+}
+};  // namespace Rain::SceneLoader
\ No newline at end of file
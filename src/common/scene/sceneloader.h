@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace Rain {
+class Scene;
+namespace SceneLoader {
+const uint32_t VERSION = 1;
+
+// Text scenes (.rscene) are line records, names may be used before they are
+// declared and paths are relative to the scene file:
+//   mesh <name> <obj file>
+//   material <name> [Ka r g b] [Kd r g b] [Ks r g b] [Ns x] [d x]
+//   object <mesh> <tx ty tz> <rx ry rz degrees> <scale> [material]
+// Binary scenes start with BinaryHeader and hold the same records, both are
+// parsed on all cores and fill scene->objects_. Meshes are acquired from
+// scene->meshes_, so each file loads once however many objects use it.
+bool Load(const std::string& scene_file, Scene* scene);
+// writes the objects of scene as a binary scene
+bool SaveBinary(const std::string& scene_file, const Scene& scene);
+
+// on-disk layout of binary scenes, the arrays follow at 16-byte aligned
+// offsets
+struct BinaryHeader {
+  char magic_[4];
+  uint32_t version_;
+  uint64_t file_size_;
+  uint32_t n_mesh_;
+  uint32_t n_material_;
+  uint64_t n_object_;
+  uint64_t meshes_offset_;     // MeshRecord
+  uint64_t materials_offset_;  // MaterialRecord
+  uint64_t objects_offset_;    // ObjectRecord
+  uint64_t strings_offset_;    // mesh paths
+};
+
+struct MeshRecord {
+  uint64_t path_offset_;  // from strings_offset_
+  uint64_t path_size_;
+};
+
+// Ka, Kd, Ks, d, Ns of one material
+struct MaterialRecord {
+  float values_[11];
+};
+
+struct ObjectRecord {
+  uint32_t mesh_;
+  int32_t material_;  // -1 for the materials of the mesh
+  float transformation_[12];  // upper 3 rows, column major
+};
+};  // namespace SceneLoader
+};  // namespace Rain
\ No newline at end of file
@@ -5,6 +5,7 @@
 
 #include "backends/imgui_impl_glfw.h"
 #include "backends/imgui_impl_vulkan.h"
+#include "helper/threadpool.h"
 #include "spdlog/spdlog.h"
 
 namespace Rain {
@@ -17,6 +18,13 @@ Engine::Engine() {
 }
 
 void Engine::Init() {
+  // the meshes of the scene load on worker threads while the window and
+  // device are set up
+  if (!scene_.Init(scene_file_)) {
+    spdlog::error("{} loading failed", scene_file_);
+    exit(1);
+  }
+
   {  // init window
     glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
@@ -118,14 +126,17 @@ void Engine::Init() {
     uint32_t graphics_queue_family, present_queue_family;
     physical_device_->GetGraphicsPresentQueueFamily(graphics_queue_family,
                                                     present_queue_family);
+    uint32_t transfer_queue_family =
+        physical_device_->GetTransferQueueFamily(graphics_queue_family);
     if (enable_validation_layers_) {
       result = device_->Init(physical_device_->device_, graphics_queue_family,
-                             present_queue_family, &validation_layers_,
-                             &physical_device_->device_extensions_);
+                             present_queue_family, transfer_queue_family,
+                             &validation_layers_,
+                             &physical_device_->enabled_extensions_);
     } else
       result = device_->Init(physical_device_->device_, graphics_queue_family,
-                             present_queue_family, nullptr,
-                             &physical_device_->device_extensions_);
+                             present_queue_family, transfer_queue_family,
+                             nullptr, &physical_device_->enabled_extensions_);
     if (result != VK_SUCCESS) {
       CleanUp();
       exit(1);
@@ -146,7 +157,6 @@ void Engine::Init() {
   }
 
   {  // scene
-    scene_.Init();
     if (render_scene_.Init(device_, swap_chain_, &scene_) != VK_SUCCESS) {
       CleanUp();
       exit(1);
@@ -171,8 +181,8 @@ void Engine::Init() {
 
   {  // create pipeline
     pipeline_ = new Pipeline;
-    if (pipeline_->Init(device_->device_, swap_chain_->extent_,
-                        render_pass_->render_pass_,
+    if (pipeline_->Init(device_->device_, device_->pipeline_cache_,
+                        swap_chain_->extent_, render_pass_->render_pass_,
                         &render_scene_) != VK_SUCCESS) {
       spdlog::error("pipeline creation failed");
       CleanUp();
@@ -201,10 +211,24 @@ void Engine::Init() {
     }
     spdlog::debug("framebuffers created");
   }
+  InitDepthPyramid();
 
   // allocate and record command buffers
   device_->AllocateCommandBuffers(swap_chain_);
+  if (worker_pools_.Init(device_, swap_chain_->MAX_FRAMES_IN_FLIGHT,
+                         ThreadPool::Global().NumWorkers()) != VK_SUCCESS) {
+    CleanUp();
+    exit(1);
+  }
+  chunk_buffers_.resize(swap_chain_->MAX_FRAMES_IN_FLIGHT);
+  InvalidateDrawChunks();
   InitImGui();
+
+  // upload whatever finished loading in the meantime
+  if (render_scene_.UpdateResidency(device_) != VK_SUCCESS) {
+    CleanUp();
+    exit(1);
+  }
 }
 
 VkResult Engine::InitImGui() {
@@ -251,6 +275,7 @@ VkResult Engine::InitImGui() {
   init_info.QueueFamily = graphics_queue_family;
   init_info.Queue = device_->graphics_queue_;
   init_info.DescriptorPool = imgui_pool_;
+  init_info.PipelineCache = device_->pipeline_cache_;
   init_info.MinImageCount = swap_chain_->images_.size();
   init_info.ImageCount = swap_chain_->images_.size();
   init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
@@ -274,16 +299,48 @@ void Engine::DrawFrame() {
                        "%.0f degree");
     ImGui::SliderFloat("y angle", &render_scene_.light_y_angle_, 0.0f, 90.0f,
                        "%.0f degree");
+    MemoryAllocator::Stats memory = device_->allocator_.GetStats();
+    ImGui::Text("Memory");
+    ImGui::Text("%u blocks %.1f MB", memory.n_block_,
+                memory.block_bytes_ / 1048576.0);
+    ImGui::Text("%u allocations %.1f MB", memory.n_alloc_,
+                memory.alloc_bytes_ / 1048576.0);
+    ImGui::Text("%u dedicated %.1f MB", memory.n_dedicated_,
+                memory.dedicated_bytes_ / 1048576.0);
+    ImGui::Text("Draws");
+    ImGui::Checkbox("frustum culling", &render_scene_.culling_);
+    if (render_scene_.culler_.supported_ &&
+        render_scene_.multi_draw_indirect_) {
+      ImGui::Checkbox("GPU culling", &render_scene_.gpu_culling_);
+      ImGui::Checkbox("occlusion culling",
+                      &render_scene_.occlusion_culling_);
+    }
+    ImGui::Text("%u tested %u culled %u occluded",
+                render_scene_.cull_stats_.n_tested_,
+                render_scene_.cull_stats_.n_culled_,
+                render_scene_.cull_stats_.n_occluded_);
+    ImGui::Text("%zu commands in %zu batches%s",
+                render_scene_.gpu_culling_ ? render_scene_.templates_.size()
+                                           : render_scene_.commands_.size(),
+                render_scene_.batches_.size(),
+                render_scene_.gpu_culling_          ? " (GPU)"
+                : render_scene_.multi_draw_indirect_ ? ""
+                                                     : " (direct)");
   }
   ImGui::End();
   ImGui::Render();
+  if (render_scene_.UpdateResidency(device_) != VK_SUCCESS) {
+    CleanUp();
+    exit(1);
+  }
   uint32_t image_index = swap_chain_->BeginFrame(window_resized_);
   while (window_resized_) {
     window_resized_ = false;
     RecreateSwapChain();
     image_index = swap_chain_->BeginFrame(window_resized_);
   }
-  render_scene_.UpdateUniform(device_->device_, image_index);
+  render_scene_.UpdateUniform(device_->device_,
+                             uint32_t(swap_chain_->current_frame_));
 
   VkCommandBuffer command_buffer = device_->command_buffers_[image_index];
   vkResetCommandBuffer(command_buffer,
@@ -296,6 +353,8 @@ void Engine::DrawFrame() {
     CleanUp();
     exit(1);
   }
+  render_scene_.RecordCulling(command_buffer,
+                              uint32_t(swap_chain_->current_frame_));
   VkRenderPassBeginInfo render_pass_info{};
   render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
   render_pass_info.renderPass = render_pass_->render_pass_;
@@ -307,15 +366,46 @@ void Engine::DrawFrame() {
   clear_values[1].depthStencil = {1.0f, 0};
   render_pass_info.clearValueCount = static_cast<uint32_t>(clear_values.size());
   render_pass_info.pClearValues = clear_values.data();
+  // the pieces are recorded in parallel and executed in order, the buffers
+  // of this frame were last submitted before its fence. Only a change of
+  // the draws records them again, the primary buffer around them and the
+  // ImGui pass are recorded every frame
+  uint32_t frame = uint32_t(swap_chain_->current_frame_);
+  std::vector<VkCommandBuffer>& chunk_buffers = chunk_buffers_[frame];
+  if (chunk_versions_[frame] != render_scene_.draw_version_) {
+    if (worker_pools_.Reset(device_->device_, frame) != VK_SUCCESS) {
+      CleanUp();
+      exit(1);
+    }
+    ThreadPool& pool = ThreadPool::Global();
+    render_scene_.SplitDraws(pool.NumWorkers(), draw_chunks_);
+    chunk_buffers.resize(draw_chunks_.size());
+    std::atomic<bool> chunk_failed{false};
+    pool.ParallelFor(
+        draw_chunks_.size(), 1,
+        [&](size_t begin, size_t end, uint32_t worker) {
+          for (size_t chunk = begin; chunk < end; ++chunk) {
+            if (RecordDrawChunk(frame, uint32_t(chunk), worker) !=
+                VK_SUCCESS) {
+              chunk_failed = true;
+            }
+          }
+        });
+    if (chunk_failed) {
+      spdlog::error("draw recording failed");
+      CleanUp();
+      exit(1);
+    }
+    chunk_versions_[frame] = render_scene_.draw_version_;
+  }
   vkCmdBeginRenderPass(command_buffer, &render_pass_info,
-                       VK_SUBPASS_CONTENTS_INLINE);
-  vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                    pipeline_->pipeline_);
-  for (size_t i = 0; i < render_scene_.models_.size(); ++i) {
-    render_scene_.BindAndDraw(command_buffer, pipeline_->layout_, image_index,
-                              i);
+                       VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+  if (!chunk_buffers.empty()) {
+    vkCmdExecuteCommands(command_buffer, uint32_t(chunk_buffers.size()),
+                         chunk_buffers.data());
   }
   vkCmdEndRenderPass(command_buffer);
+  render_scene_.RecordDepthPyramid(command_buffer, image_index);
   VkRenderPassBeginInfo imgui_pass_info = {};
   imgui_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
   imgui_pass_info.renderPass = imgui_render_pass_->render_pass_;
@@ -336,6 +426,43 @@ void Engine::DrawFrame() {
   swap_chain_->EndFrame(image_index);
 }
 
+VkResult Engine::RecordDrawChunk(uint32_t frame, uint32_t chunk,
+                                 uint32_t worker) {
+  VkCommandBuffer command_buffer;
+  VkResult result =
+      worker_pools_.Allocate(device_->device_, frame, worker, command_buffer);
+  if (result != VK_SUCCESS) return result;
+  chunk_buffers_[frame][chunk] = command_buffer;
+  // no framebuffer so that the buffer runs in the pass of any swap chain
+  // image, and submitted again while the draws stay the same
+  VkCommandBufferInheritanceInfo inheritance_info{};
+  inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritance_info.renderPass = render_pass_->render_pass_;
+  inheritance_info.subpass = 0;
+  inheritance_info.framebuffer = VK_NULL_HANDLE;
+  VkCommandBufferBeginInfo begin_info{};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  begin_info.pInheritanceInfo = &inheritance_info;
+  result = vkBeginCommandBuffer(command_buffer, &begin_info);
+  if (result != VK_SUCCESS) return result;
+  // no state is inherited from the primary buffer, the piece binds all of
+  // it; one indirect draw per batch whatever the number of models
+  const DrawBatch& batch = draw_chunks_[chunk];
+  vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    pipeline_->pipelines_[batch.vertex_format_]);
+  render_scene_.BindDescriptor(command_buffer, pipeline_->layout_, frame);
+  render_scene_.vertex_pools_[batch.vertex_format_].Bind(command_buffer);
+  render_scene_.index_pools_[IndexPoolOf(batch.index_type_)].Bind(
+      command_buffer);
+  render_scene_.Draw(command_buffer, frame, batch);
+  return vkEndCommandBuffer(command_buffer);
+}
+
+void Engine::InvalidateDrawChunks() {
+  chunk_versions_.assign(chunk_buffers_.size(), UINT64_MAX);
+}
+
 void Engine::MainLoop() {
   timer_.Reset();
   while (!glfwWindowShouldClose(window_)) {
@@ -352,6 +479,7 @@ void Engine::CleanUp() {
     vkDestroyDescriptorPool(device_->device_, imgui_pool_, nullptr);
   }
   render_scene_.Destroy(device_->device_);
+  worker_pools_.Destroy(device_->device_);
   scene_.Destroy();
   if (instance_) {
     if (device_) {
@@ -381,6 +509,7 @@ void Engine::CleanUp() {
         framebuffer.Destroy(device_->device_);
       }
       spdlog::debug("framebuffers destroyed");
+      device_->SavePipelineCache();
       device_->Destroy();
       delete device_;
     }
@@ -439,6 +568,7 @@ std::vector<const char*> Engine::GetRequiredExtensions() {
 
 void Engine::CleanUpSwapChain() {
   render_scene_.DestroyUniform(device_->device_);
+  render_scene_.culler_.DestroyPyramid(device_->device_);
   for (auto framebuffer : framebuffers_) {
     framebuffer.Destroy(device_->device_);
   }
@@ -505,8 +635,8 @@ void Engine::RecreateSwapChain() {
   }
 
   {  // create pipeline
-    if (pipeline_->Init(device_->device_, swap_chain_->extent_,
-                        render_pass_->render_pass_,
+    if (pipeline_->Init(device_->device_, device_->pipeline_cache_,
+                        swap_chain_->extent_, render_pass_->render_pass_,
                         &render_scene_) != VK_SUCCESS) {
       spdlog::error("pipeline creation failed");
       CleanUp();
@@ -532,14 +662,28 @@ void Engine::RecreateSwapChain() {
       }
     }
   }
+  InitDepthPyramid();
 
   // allocate and record command buffers
   device_->AllocateCommandBuffers(swap_chain_);
+  // recorded with the destroyed render pass and pipelines
+  InvalidateDrawChunks();
 
   // imgui
   ImGui_ImplVulkan_SetMinImageCount(swap_chain_->images_.size());
 }
 
+void Engine::InitDepthPyramid() {
+  std::vector<Image*> depth_images;
+  for (auto& framebuffer : framebuffers_) {
+    depth_images.push_back(&framebuffer.depth_image_);
+  }
+  if (render_scene_.culler_.InitPyramid(device_, depth_images) != VK_SUCCESS) {
+    CleanUp();
+    exit(1);
+  }
+}
+
 void Engine::WindowResizeCallback(GLFWwindow* window, int width, int height) {
   auto engine = reinterpret_cast<Engine*>(glfwGetWindowUserPointer(window));
   engine->window_resized_ = true;
@@ -5,9 +5,11 @@
 
 #include <array>
 #include <cmath>
+#include <string>
 #include <vector>
 
 #include "camera/camera.h"
+#include "command/workerpools.h"
 #include "device/device.h"
 #include "device/physicaldevice.h"
 #include "framebuffer/framebuffer.h"
@@ -33,6 +35,14 @@ class Engine {
   RenderPass* render_pass_ = nullptr;
   Pipeline* pipeline_ = nullptr;
   std::vector<Framebuffer> framebuffers_;
+  // the scene pass is recorded by the workers of ThreadPool::Global(), one
+  // secondary command buffer per piece of draw_chunks_. The buffers of a
+  // frame in flight are kept and executed again while the draws stay at
+  // the RenderScene::draw_version_ they were recorded at
+  WorkerCommandPools worker_pools_;
+  std::vector<DrawBatch> draw_chunks_;
+  std::vector<std::vector<VkCommandBuffer>> chunk_buffers_;  // per frame
+  std::vector<uint64_t> chunk_versions_;
   StepTimer timer_;
 
   VkDescriptorPool imgui_pool_ = VK_NULL_HANDLE;
@@ -51,6 +61,7 @@ class Engine {
   float height_scale_;
   bool window_resized_ = false;
 
+  std::string scene_file_ = "../assets/scenes/default.rscene";
   Scene scene_;
   RenderScene render_scene_;
 
@@ -60,6 +71,11 @@ class Engine {
   void Init();
   VkResult InitImGui();
   void DrawFrame();
+  // the draws of draw_chunks_[chunk] into a secondary command buffer of the
+  // scene pass, for any framebuffer
+  VkResult RecordDrawChunk(uint32_t frame, uint32_t chunk, uint32_t worker);
+  // the secondary buffers of every frame are recorded again at next use
+  void InvalidateDrawChunks();
   void UpdateGlobalUniformBuffer(uint32_t image_index);
   void MainLoop();
   void CleanUp();
@@ -67,6 +83,8 @@ class Engine {
   std::vector<const char*> GetRequiredExtensions();
   void CleanUpSwapChain();
   void RecreateSwapChain();
+  // the depth pyramid of the GPU culling over the depth of framebuffers_
+  void InitDepthPyramid();
   static void WindowResizeCallback(GLFWwindow* window, int width, int height);
   static void KeyCallback(GLFWwindow* window, int key, int scancode, int action,
                           int mods);
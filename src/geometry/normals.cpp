@@ -0,0 +1,121 @@
+#include "normals.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+
+#include "helper/threadpool.h"
+
+namespace Rain {
+namespace {
+const size_t GRAIN = 16 * 1024;
+const size_t BLOCK = 16;  // faces per vectorized block
+}  // namespace
+
+void NormalSolver::Init(size_t n_vert, size_t n_face,
+                        const uint32_t* indices) {
+  n_vert_ = n_vert;
+  n_face_ = n_face;
+  indices_ = indices;
+  ThreadPool& pool = ThreadPool::Global();
+
+  std::unique_ptr<std::atomic<uint32_t>[]> cursor(
+      new std::atomic<uint32_t>[n_vert]);
+  pool.ParallelFor(n_vert, GRAIN, [&](size_t begin, size_t end, uint32_t) {
+    for (size_t v = begin; v < end; ++v) cursor[v].store(0);
+  });
+  pool.ParallelFor(3 * n_face, GRAIN, [&](size_t begin, size_t end, uint32_t) {
+    for (size_t c = begin; c < end; ++c) {
+      cursor[indices[c]].fetch_add(1, std::memory_order_relaxed);
+    }
+  });
+  offsets_.resize(n_vert + 1);
+  offsets_[0] = 0;
+  for (size_t v = 0; v < n_vert; ++v) {
+    uint32_t degree = cursor[v].load();
+    offsets_[v + 1] = offsets_[v] + degree;
+    cursor[v].store(offsets_[v]);
+  }
+  faces_.resize(3 * n_face);
+  pool.ParallelFor(3 * n_face, GRAIN, [&](size_t begin, size_t end, uint32_t) {
+    for (size_t c = begin; c < end; ++c) {
+      uint32_t slot =
+          cursor[indices[c]].fetch_add(1, std::memory_order_relaxed);
+      faces_[slot] = uint32_t(c / 3);
+    }
+  });
+  // the fill order depends on the threads, sort it so sums are reproducible
+  pool.ParallelFor(n_vert, GRAIN, [&](size_t begin, size_t end, uint32_t) {
+    for (size_t v = begin; v < end; ++v) {
+      std::sort(faces_.begin() + offsets_[v], faces_.begin() + offsets_[v + 1]);
+    }
+  });
+
+  nx_.resize(n_face);
+  ny_.resize(n_face);
+  nz_.resize(n_face);
+}
+
+void NormalSolver::Compute(const Vec3f* vertices, Vec3f* normals) {
+  ThreadPool& pool = ThreadPool::Global();
+  const uint32_t* indices = indices_;
+  float* nx = nx_.data();
+  float* ny = ny_.data();
+  float* nz = nz_.data();
+
+  // face normals, gathered into blocks so the math runs over plain arrays
+  pool.ParallelFor(n_face_, GRAIN, [&](size_t begin, size_t end, uint32_t) {
+    alignas(32) float ax[BLOCK], ay[BLOCK], az[BLOCK];
+    alignas(32) float bx[BLOCK], by[BLOCK], bz[BLOCK];
+    alignas(32) float cx[BLOCK], cy[BLOCK], cz[BLOCK];
+    for (size_t f0 = begin; f0 < end; f0 += BLOCK) {
+      size_t n = std::min(BLOCK, end - f0);
+      for (size_t i = 0; i < BLOCK; ++i) {
+        size_t f = f0 + std::min(i, n - 1);
+        const Vec3f& p0 = vertices[indices[3 * f]];
+        const Vec3f& p1 = vertices[indices[3 * f + 1]];
+        const Vec3f& p2 = vertices[indices[3 * f + 2]];
+        ax[i] = p1.x() - p0.x();
+        ay[i] = p1.y() - p0.y();
+        az[i] = p1.z() - p0.z();
+        bx[i] = p2.x() - p0.x();
+        by[i] = p2.y() - p0.y();
+        bz[i] = p2.z() - p0.z();
+      }
+      for (size_t i = 0; i < BLOCK; ++i) {
+        float x = ay[i] * bz[i] - az[i] * by[i];
+        float y = az[i] * bx[i] - ax[i] * bz[i];
+        float z = ax[i] * by[i] - ay[i] * bx[i];
+        float length = std::sqrt(x * x + y * y + z * z);
+        // degenerate faces contribute nothing
+        float inv = length > 0.0f ? 1.0f / length : 0.0f;
+        cx[i] = x * inv;
+        cy[i] = y * inv;
+        cz[i] = z * inv;
+      }
+      for (size_t i = 0; i < n; ++i) {
+        nx[f0 + i] = cx[i];
+        ny[f0 + i] = cy[i];
+        nz[f0 + i] = cz[i];
+      }
+    }
+  });
+
+  // every vertex sums its own faces
+  pool.ParallelFor(n_vert_, GRAIN, [&](size_t begin, size_t end, uint32_t) {
+    for (size_t v = begin; v < end; ++v) {
+      float x = 0.0f, y = 0.0f, z = 0.0f;
+      for (uint32_t i = offsets_[v]; i < offsets_[v + 1]; ++i) {
+        uint32_t f = faces_[i];
+        x += nx[f];
+        y += ny[f];
+        z += nz[f];
+      }
+      float length = std::sqrt(x * x + y * y + z * z);
+      float inv = length > 0.0f ? 1.0f / length : 0.0f;
+      normals[v] = Vec3f(x * inv, y * inv, z * inv);
+    }
+  });
+}
+};  // namespace Rain
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "mathtype.h"
+
+namespace Rain {
+// Vertex normals as the normalized sum of the unit normals of the adjacent
+// faces. The adjacency only depends on the topology, so one solver can run
+// Compute every frame on deforming vertices. Every vertex gathers from its
+// own faces, no two threads write the same normal.
+class NormalSolver {
+ public:
+  size_t n_vert_ = 0;
+  size_t n_face_ = 0;
+  const uint32_t* indices_ = nullptr;
+  // vertex -> face adjacency in CSR form, faces of a vertex are sorted
+  std::vector<uint32_t> offsets_;
+  std::vector<uint32_t> faces_;
+  // unit face normals, SoA so the cross products vectorize
+  std::vector<float> nx_;
+  std::vector<float> ny_;
+  std::vector<float> nz_;
+
+  // indices must outlive the solver
+  void Init(size_t n_vert, size_t n_face, const uint32_t* indices);
+  void Compute(const Vec3f* vertices, Vec3f* normals);
+};
+};  // namespace Rain
\ No newline at end of file
@@ -0,0 +1,69 @@
+#include "quantize.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "helper/threadpool.h"
+
+namespace Rain::Quantize {
+namespace {
+const size_t GRAIN = 16 * 1024;
+
+inline float SignNotZero(float x) { return x >= 0.0f ? 1.0f : -1.0f; }
+
+inline int16_t ToSnorm16(float x) {
+  return int16_t(std::lround(std::clamp(x, -1.0f, 1.0f) * 32767.0f));
+}
+
+inline uint16_t ToUnorm16(float x) {
+  return uint16_t(std::lround(std::clamp(x, 0.0f, 1.0f) * 65535.0f));
+}
+}  // namespace
+
+Vec3f Extent(const Vec3f& bbox_min, const Vec3f& bbox_max) {
+  return (bbox_max - bbox_min).cwiseMax(1e-6f);
+}
+
+void EncodePositions(size_t n, const Vec3f* positions, const Vec3f& bbox_min,
+                     const Vec3f& bbox_extent, Position* out) {
+  Vec3f scale = bbox_extent.cwiseInverse();
+  ThreadPool::Global().ParallelFor(
+      n, GRAIN, [&](size_t begin, size_t end, uint32_t) {
+        for (size_t i = begin; i < end; ++i) {
+          Vec3f p = (positions[i] - bbox_min).cwiseProduct(scale);
+          out[i] = {{ToUnorm16(p[0]), ToUnorm16(p[1]), ToUnorm16(p[2]), 0}};
+        }
+      });
+}
+
+void EncodeNormals(size_t n, const Vec3f* normals, Normal* out) {
+  ThreadPool::Global().ParallelFor(
+      n, GRAIN, [&](size_t begin, size_t end, uint32_t) {
+        for (size_t i = begin; i < end; ++i) {
+          // project on the octahedron, fold the lower half over the upper
+          const Vec3f& v = normals[i];
+          float l1 = std::abs(v[0]) + std::abs(v[1]) + std::abs(v[2]);
+          float x = l1 > 0.0f ? v[0] / l1 : 0.0f;
+          float y = l1 > 0.0f ? v[1] / l1 : 0.0f;
+          if (v[2] < 0.0f) {
+            float fx = (1.0f - std::abs(y)) * SignNotZero(x);
+            float fy = (1.0f - std::abs(x)) * SignNotZero(y);
+            x = fx;
+            y = fy;
+          }
+          out[i] = {{ToSnorm16(x), ToSnorm16(y)}};
+        }
+      });
+}
+
+// same as OctDecode in basic.vert
+Vec3f DecodeNormal(const Normal& normal) {
+  float x = std::max(normal.xy_[0] / 32767.0f, -1.0f);
+  float y = std::max(normal.xy_[1] / 32767.0f, -1.0f);
+  Vec3f v(x, y, 1.0f - std::abs(x) - std::abs(y));
+  float t = std::max(-v[2], 0.0f);
+  v[0] += v[0] >= 0.0f ? -t : t;
+  v[1] += v[1] >= 0.0f ? -t : t;
+  return v.normalized();
+}
+};  // namespace Rain::Quantize
\ No newline at end of file
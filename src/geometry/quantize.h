@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "mathtype.h"
+
+namespace Rain {
+namespace Quantize {
+// position as 16-bit unorm within [bbox_min, bbox_min + bbox_extent], the
+// 4th component pads the vertex to 8 bytes
+struct Position {
+  uint16_t xyzw_[4];
+};
+
+// octahedral unit vector as 2 16-bit snorms
+struct Normal {
+  int16_t xy_[2];
+};
+
+// extent of the box the positions are quantized to, never 0 on an axis
+Vec3f Extent(const Vec3f& bbox_min, const Vec3f& bbox_max);
+void EncodePositions(size_t n, const Vec3f* positions, const Vec3f& bbox_min,
+                     const Vec3f& bbox_extent, Position* out);
+void EncodeNormals(size_t n, const Vec3f* normals, Normal* out);
+Vec3f DecodeNormal(const Normal& normal);
+};  // namespace Quantize
+};  // namespace Rain
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include "reorder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+#include <vector>
+
+namespace Rain::Reorder {
+namespace {
+const uint32_t NONE = UINT32_MAX;
+const uint32_t MAX_VALENCE_SCORE = 32;
+
+// Forsyth's scoring: the 3 most recent vertices score a flat 0.75 so the
+// strip does not turn back on itself, older entries decay with their cache
+// position and vertices with few triangles left are boosted so they do not
+// end up as isolated triangles at the end
+struct ScoreTable {
+  float cache_[CACHE_SIZE];
+  float valence_[MAX_VALENCE_SCORE];
+
+  ScoreTable() {
+    for (uint32_t i = 0; i < CACHE_SIZE; ++i) {
+      cache_[i] = i < 3 ? 0.75f
+                        : std::pow(1.0f - float(i - 3) / (CACHE_SIZE - 3), 1.5f);
+    }
+    valence_[0] = 0.0f;
+    for (uint32_t i = 1; i < MAX_VALENCE_SCORE; ++i) {
+      valence_[i] = 2.0f / std::sqrt(float(i));
+    }
+  }
+
+  float Score(uint32_t cache_pos, uint32_t remaining) const {
+    if (remaining == 0) return -1.0f;
+    float score = cache_pos < CACHE_SIZE ? cache_[cache_pos] : 0.0f;
+    return score + (remaining < MAX_VALENCE_SCORE
+                        ? valence_[remaining]
+                        : 2.0f / std::sqrt(float(remaining)));
+  }
+};
+}  // namespace
+
+CacheStats Analyze(const uint32_t* indices, size_t n_index, size_t n_vert,
+                   uint32_t cache_size) {
+  // a vertex is still cached while fewer than cache_size misses followed it
+  std::vector<uint64_t> time(n_vert, 0);
+  uint64_t misses = 0;
+  for (size_t i = 0; i < n_index; ++i) {
+    uint32_t v = indices[i];
+    if (time[v] == 0 || misses - time[v] >= cache_size) {
+      time[v] = ++misses;
+    }
+  }
+  size_t n_used = n_vert - size_t(std::count(time.begin(), time.end(), 0));
+  CacheStats stats;
+  stats.acmr_ = n_index ? float(misses) / float(n_index / 3) : 0.0f;
+  stats.atvr_ = n_used ? float(misses) / float(n_used) : 0.0f;
+  return stats;
+}
+
+void OptimizeCache(uint32_t* indices, size_t n_index, size_t n_vert) {
+  static const ScoreTable table;
+  size_t n_tri = n_index / 3;
+  if (n_tri < 2) return;
+
+  // vertex -> live triangles, a triangle is swapped out of the lists of its
+  // vertices once emitted so remaining_ counts the live prefix
+  std::vector<uint32_t> remaining(n_vert, 0);
+  for (size_t i = 0; i < n_tri * 3; ++i) ++remaining[indices[i]];
+  std::vector<uint32_t> offsets(n_vert + 1, 0);
+  for (size_t v = 0; v < n_vert; ++v) offsets[v + 1] = offsets[v] + remaining[v];
+  std::vector<uint32_t> tris(n_tri * 3);
+  {
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < n_tri * 3; ++i) {
+      tris[fill[indices[i]]++] = uint32_t(i / 3);
+    }
+  }
+
+  std::vector<uint32_t> cache_pos(n_vert, NONE);
+  std::vector<float> vert_score(n_vert);
+  for (size_t v = 0; v < n_vert; ++v) {
+    vert_score[v] = table.Score(NONE, remaining[v]);
+  }
+  std::vector<float> tri_score(n_tri);
+  std::vector<bool> emitted(n_tri, false);
+  uint32_t best = 0;
+  for (size_t t = 0; t < n_tri; ++t) {
+    const uint32_t* tri = indices + 3 * t;
+    tri_score[t] =
+        vert_score[tri[0]] + vert_score[tri[1]] + vert_score[tri[2]];
+    if (tri_score[t] > tri_score[best]) best = uint32_t(t);
+  }
+
+  std::vector<uint32_t> output(n_tri * 3);
+  uint32_t cache[CACHE_SIZE + 3];
+  uint32_t new_cache[CACHE_SIZE + 3];
+  uint32_t cache_size = 0;
+  size_t cursor = 0;
+  for (size_t n_out = 0; n_out < n_tri; ++n_out) {
+    if (best == NONE) {
+      // nothing in the cache has triangles left, restart at the next one
+      while (emitted[cursor]) ++cursor;
+      best = uint32_t(cursor);
+    }
+    const uint32_t* tri = indices + 3 * best;
+    std::copy(tri, tri + 3, output.begin() + 3 * n_out);
+    emitted[best] = true;
+
+    uint32_t new_size = 0;
+    for (int k = 0; k < 3; ++k) {
+      uint32_t v = tri[k];
+      uint32_t* list = tris.data() + offsets[v];
+      uint32_t* end = list + remaining[v];
+      uint32_t* it = std::find(list, end, best);
+      if (it != end) {
+        *it = *(end - 1);
+        --remaining[v];
+      }
+      if (std::find(new_cache, new_cache + new_size, v) ==
+          new_cache + new_size)
+        new_cache[new_size++] = v;
+    }
+    for (uint32_t i = 0; i < cache_size; ++i) {
+      uint32_t v = cache[i];
+      if (v != tri[0] && v != tri[1] && v != tri[2]) new_cache[new_size++] = v;
+    }
+
+    // rescore what moved in or fell out of the cache and pick the best
+    // triangle among the ones still touching it
+    best = NONE;
+    float best_score = -1.0f;
+    for (uint32_t i = 0; i < new_size; ++i) {
+      uint32_t v = new_cache[i];
+      cache_pos[v] = i < CACHE_SIZE ? i : NONE;
+      vert_score[v] = table.Score(cache_pos[v], remaining[v]);
+    }
+    for (uint32_t i = 0; i < new_size; ++i) {
+      uint32_t v = new_cache[i];
+      for (uint32_t j = offsets[v]; j < offsets[v] + remaining[v]; ++j) {
+        uint32_t t = tris[j];
+        const uint32_t* adj = indices + 3 * t;
+        tri_score[t] =
+            vert_score[adj[0]] + vert_score[adj[1]] + vert_score[adj[2]];
+        if (i < CACHE_SIZE && tri_score[t] > best_score) {
+          best_score = tri_score[t];
+          best = t;
+        }
+      }
+    }
+    cache_size = std::min(new_size, CACHE_SIZE);
+    std::copy(new_cache, new_cache + cache_size, cache);
+  }
+  std::copy(output.begin(), output.end(), indices);
+}
+
+void OptimizeFetch(uint32_t* indices, size_t n_index, size_t n_vert,
+                   Vec3f* vertices, Vec3f* normals, Vec2f* texcoords) {
+  std::vector<uint32_t> remap(n_vert, NONE);
+  uint32_t next = 0;
+  for (size_t i = 0; i < n_index; ++i) {
+    uint32_t& v = remap[indices[i]];
+    if (v == NONE) v = next++;
+    indices[i] = v;
+  }
+  for (auto& v : remap) {
+    if (v == NONE) v = next++;
+  }
+
+  auto permute = [&](auto* data) {
+    if (!data) return;
+    using T = std::remove_pointer_t<decltype(data)>;
+    std::vector<T> old(data, data + n_vert);
+    for (size_t i = 0; i < n_vert; ++i) data[remap[i]] = old[i];
+  };
+  permute(vertices);
+  permute(normals);
+  permute(texcoords);
+}
+};  // namespace Rain::Reorder
\ No newline at end of file
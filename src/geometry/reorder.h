@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "mathtype.h"
+
+namespace Rain {
+namespace Reorder {
+// post-transform cache that OptimizeCache targets
+const uint32_t CACHE_SIZE = 32;
+
+struct CacheStats {
+  float acmr_;  // average cache misses per triangle, 0.5 at best
+  float atvr_;  // average transforms per used vertex, 1.0 at best
+};
+
+// replays indices through a FIFO of cache_size vertices, as the vertex
+// reuse of most GPUs behaves
+CacheStats Analyze(const uint32_t* indices, size_t n_index, size_t n_vert,
+                   uint32_t cache_size = 16);
+// Reorders the triangles of indices for post-transform cache hits with
+// Forsyth's linear-speed algorithm. Triangles keep their winding and stay
+// within [indices, indices + n_index), so draw ranges remain valid.
+void OptimizeCache(uint32_t* indices, size_t n_index, size_t n_vert);
+// Renumbers the vertices in order of first use by indices, so the vertex
+// fetches of a draw walk the buffers forward. Unused vertices go last.
+// normals and texcoords may be null.
+void OptimizeFetch(uint32_t* indices, size_t n_index, size_t n_vert,
+                   Vec3f* vertices, Vec3f* normals, Vec2f* texcoords);
+};  // namespace Reorder
+};  // namespace Rain
\ No newline at end of file
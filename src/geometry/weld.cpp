@@ -0,0 +1,155 @@
+#include "weld.h"
+
+#include <algorithm>
+
+#include "helper/threadpool.h"
+
+namespace Rain::Weld {
+namespace {
+const size_t GRAIN = 64 * 1024;
+
+inline uint32_t Hash(uint32_t v, uint32_t vt, uint32_t vn) {
+  uint32_t h = v * 0x9E3779B1u;
+  h ^= (vt + 0x165667B1u) * 0x85EBCA77u;
+  h ^= (vn + 0x27D4EB2Fu) * 0xC2B2AE3Du;
+  h ^= h >> 15;
+  h *= 0x2C1B3C6Du;
+  h ^= h >> 12;
+  h *= 0x297A2D39u;
+  h ^= h >> 15;
+  return h;
+}
+
+// open addressing with linear probing, the key is stored inline so a probe
+// never leaves the slot array
+struct Table {
+  struct Slot {
+    uint32_t v_;
+    uint32_t vt_;
+    uint32_t vn_;
+    uint32_t id_;
+  };
+  std::vector<Slot> slots_;
+  uint32_t mask_ = 0;
+  uint32_t size_ = 0;
+
+  void Init(size_t capacity) {
+    size_t n = 16;
+    while (n < capacity) n <<= 1;
+    slots_.assign(n, Slot{0, 0, 0, NONE});
+    mask_ = uint32_t(n - 1);
+    size_ = 0;
+  }
+
+  // id of the triplet, id is taken when it is new
+  uint32_t Insert(uint32_t h, uint32_t v, uint32_t vt, uint32_t vn,
+                  uint32_t id) {
+    if (2 * (size_ + 1) > slots_.size()) Grow();
+    for (uint32_t i = h & mask_;; i = (i + 1) & mask_) {
+      Slot& slot = slots_[i];
+      if (slot.id_ == NONE) {
+        slot = Slot{v, vt, vn, id};
+        ++size_;
+        return id;
+      }
+      if (slot.v_ == v && slot.vt_ == vt && slot.vn_ == vn) return slot.id_;
+    }
+  }
+
+  void Grow() {
+    std::vector<Slot> old;
+    old.swap(slots_);
+    Init(2 * old.size());
+    for (const Slot& slot : old) {
+      if (slot.id_ == NONE) continue;
+      uint32_t i = Hash(slot.v_, slot.vt_, slot.vn_) & mask_;
+      while (slots_[i].id_ != NONE) i = (i + 1) & mask_;
+      slots_[i] = slot;
+      ++size_;
+    }
+  }
+};
+}  // namespace
+
+uint32_t Build(size_t n_corner, const uint32_t* v, const uint32_t* vt,
+               const uint32_t* vn, uint32_t* remap,
+               std::vector<uint32_t>& first) {
+  first.clear();
+  if (n_corner == 0) return 0;
+  ThreadPool& pool = ThreadPool::Global();
+  auto get_vt = [vt](size_t c) { return vt ? vt[c] : NONE; };
+  auto get_vn = [vn](size_t c) { return vn ? vn[c] : NONE; };
+
+  std::vector<uint32_t> hashes(n_corner);
+  pool.ParallelFor(n_corner, GRAIN, [&](size_t begin, size_t end, uint32_t) {
+    for (size_t c = begin; c < end; ++c) {
+      hashes[c] = Hash(v[c], get_vt(c), get_vn(c));
+    }
+  });
+
+  // the high hash bits pick a partition, every partition has its own table
+  // and walks the corners in order, so no locks are needed
+  uint32_t bits = 0;
+  while ((1u << bits) < pool.NumWorkers() &&
+         (n_corner >> bits) > GRAIN)
+    ++bits;
+  uint32_t n_part = 1u << bits;
+  auto part_of = [bits](uint32_t h) {
+    return bits ? h >> (32 - bits) : 0u;
+  };
+  std::vector<std::vector<uint32_t>> part_first(n_part);
+  std::vector<uint8_t> is_first(n_corner, 0);
+  pool.ParallelFor(n_part, 1, [&](size_t begin, size_t end, uint32_t) {
+    for (size_t p = begin; p < end; ++p) {
+      Table table;
+      table.Init(2 * n_corner / n_part / 4);
+      std::vector<uint32_t>& firsts = part_first[p];
+      for (size_t c = 0; c < n_corner; ++c) {
+        uint32_t h = hashes[c];
+        if (part_of(h) != p) continue;
+        uint32_t id = table.Insert(h, v[c], get_vt(c), get_vn(c),
+                                   uint32_t(firsts.size()));
+        if (id == firsts.size()) {
+          firsts.push_back(uint32_t(c));
+          is_first[c] = 1;
+        }
+        remap[c] = id;  // local to the partition for now
+      }
+    }
+  });
+
+  // number the vertices by their first corner, as a serial pass would
+  size_t n_block = (n_corner + GRAIN - 1) / GRAIN;
+  std::vector<uint32_t> block_offset(n_block + 1, 0);
+  pool.ParallelFor(n_block, 1, [&](size_t begin, size_t end, uint32_t) {
+    for (size_t b = begin; b < end; ++b) {
+      size_t c_end = std::min(n_corner, (b + 1) * GRAIN);
+      uint32_t n = 0;
+      for (size_t c = b * GRAIN; c < c_end; ++c) n += is_first[c];
+      block_offset[b + 1] = n;
+    }
+  });
+  for (size_t b = 0; b < n_block; ++b) block_offset[b + 1] += block_offset[b];
+  uint32_t n_vert = block_offset[n_block];
+  first.resize(n_vert);
+  // global vertex of every first corner, stored at the corner
+  std::vector<uint32_t> corner_vert(n_corner);
+  pool.ParallelFor(n_block, 1, [&](size_t begin, size_t end, uint32_t) {
+    for (size_t b = begin; b < end; ++b) {
+      size_t c_end = std::min(n_corner, (b + 1) * GRAIN);
+      uint32_t id = block_offset[b];
+      for (size_t c = b * GRAIN; c < c_end; ++c) {
+        if (!is_first[c]) continue;
+        corner_vert[c] = id;
+        first[id++] = uint32_t(c);
+      }
+    }
+  });
+  pool.ParallelFor(n_corner, GRAIN, [&](size_t begin, size_t end, uint32_t) {
+    for (size_t c = begin; c < end; ++c) {
+      remap[c] = corner_vert[part_first[part_of(hashes[c])][remap[c]]];
+    }
+  });
+  return n_vert;
+}
+};  // namespace Rain::Weld
\ No newline at end of file
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Rain {
+namespace Weld {
+const uint32_t NONE = UINT32_MAX;
+
+// Merges the face corners that share a (position, texcoord, normal) index
+// triplet into one vertex. vt and vn may be null. remap receives the vertex
+// of every corner, vertices are numbered in order of first use and first
+// receives the corner each vertex was first seen at. Returns the vertex count.
+uint32_t Build(size_t n_corner, const uint32_t* v, const uint32_t* vt,
+               const uint32_t* vn, uint32_t* remap,
+               std::vector<uint32_t>& first);
+};  // namespace Weld
+};  // namespace Rain
\ No newline at end of file
@@ -5,7 +5,7 @@
 
 using namespace Rain;
 
-int main() {
+int main(int argc, char** argv) {
   spdlog::set_pattern("[%^%l%$] %v");
 #ifdef NDEBUG
   spdlog::set_level(spdlog::level::info);
@@ -13,6 +13,7 @@ int main() {
   spdlog::set_level(spdlog::level::debug);
 #endif
   Engine engine;
+  if (argc > 1) engine.scene_file_ = argv[1];
   engine.Init();
   engine.MainLoop();
   engine.CleanUp();
@@ -8,16 +8,12 @@ VkResult Buffer::Allocate(Device* device, const void* data, uint64_t size,
   size_ = size;
   properties_ = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
                 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-  VkResult result =
-      CreateBuffer(device, size, usage_flags, properties_, buffer_, memory_);
+  allocator_ = &device->allocator_;
+  VkResult result = CreateBuffer(device, size, usage_flags, properties_,
+                                 buffer_, allocation_);
   if (result != VK_SUCCESS) return result;
 
-  if (data) {
-    void* mapped_ptr;
-    vkMapMemory(device->device_, memory_, 0, size_, 0, &mapped_ptr);
-    memcpy(mapped_ptr, data, static_cast<uint32_t>(size));
-    vkUnmapMemory(device->device_, memory_);
-  }
+  if (data) memcpy(allocation_.mapped_, data, static_cast<size_t>(size));
 
   return VK_SUCCESS;
 }
@@ -27,45 +23,45 @@ VkResult Buffer::AllocateDeviceLocal(Device* device, const void* data,
                                      VkBufferUsageFlagBits usage_flags) {
   VkResult result;
   size_ = size;
-
-  VkBuffer staging_buffer;
-  VkDeviceMemory staging_memory;
-
-  result = CreateBuffer(device, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                        staging_buffer, staging_memory);
-  if (result != VK_SUCCESS) return result;
-
-  if (data) {
-    void* mapped_ptr;
-    vkMapMemory(device->device_, staging_memory, 0, size, 0, &mapped_ptr);
-    memcpy(mapped_ptr, data, static_cast<uint32_t>(size));
-    vkUnmapMemory(device->device_, staging_memory);
-  }
+  properties_ = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 
   VkBufferUsageFlagBits usage_dst = static_cast<VkBufferUsageFlagBits>(
       usage_flags | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
-  result = CreateBuffer(device, size, usage_dst,
-                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer_, memory_);
+  allocator_ = &device->allocator_;
+  result =
+      CreateBuffer(device, size, usage_dst, properties_, buffer_, allocation_);
   if (result != VK_SUCCESS) return result;
 
-  CopyBuffer(device, staging_buffer, buffer_, size);
-  vkDestroyBuffer(device->device_, staging_buffer, nullptr);
-  vkFreeMemory(device->device_, staging_memory, nullptr);
+  if (data) return Update(device, data, size);
   return VK_SUCCESS;
 }
 
+VkResult Buffer::Update(Device* device, const void* data, uint64_t size,
+                        VkDeviceSize offset) {
+  return device->uploader_.Upload(buffer_, offset, data, size);
+}
+
 VkResult Buffer::CreateBuffer(Device* device, uint64_t size,
                               VkBufferUsageFlagBits usage_flags,
                               VkMemoryPropertyFlags properties,
-                              VkBuffer& buffer, VkDeviceMemory& memory) {
+                              VkBuffer& buffer, Allocation& allocation) {
   VkResult result;
   VkBufferCreateInfo buffer_info{};
   buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   buffer_info.size = static_cast<VkDeviceSize>(size);
   buffer_info.usage = usage_flags;
   buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  // the uploader copies on the transfer queue into buffers the graphics
+  // queue already draws from, an exclusive buffer would need a graphics to
+  // transfer ownership release before every upload to keep its contents
+  uint32_t families[2] = {device->graphics_queue_family_,
+                          device->transfer_queue_family_};
+  if ((usage_flags & VK_BUFFER_USAGE_TRANSFER_DST_BIT) &&
+      families[0] != families[1]) {
+    buffer_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    buffer_info.queueFamilyIndexCount = 2;
+    buffer_info.pQueueFamilyIndices = families;
+  }
   result = vkCreateBuffer(device->device_, &buffer_info, nullptr, &buffer);
   if (result != VK_SUCCESS) {
     spdlog::error("buffer allocation failed: size={} code={}", size, result);
@@ -75,28 +71,31 @@ VkResult Buffer::CreateBuffer(Device* device, uint64_t size,
   VkMemoryRequirements mem_req;
   vkGetBufferMemoryRequirements(device->device_, buffer, &mem_req);
 
-  VkMemoryAllocateInfo alloc_info{};
-  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  alloc_info.allocationSize = mem_req.size;
-  alloc_info.memoryTypeIndex =
+  uint32_t memory_type =
       device->FindMemoryTypeIndex(mem_req.memoryTypeBits, properties);
-  result = vkAllocateMemory(device->device_, &alloc_info, nullptr, &memory);
+  result = device->allocator_.Allocate(mem_req, memory_type, false, allocation);
   if (result != VK_SUCCESS) {
-    spdlog::error("memory allocation failed");
+    vkDestroyBuffer(device->device_, buffer, nullptr);
+    buffer = VK_NULL_HANDLE;
     return result;
   }
 
-  vkBindBufferMemory(device->device_, buffer, memory, 0);
+  vkBindBufferMemory(device->device_, buffer, allocation.memory_,
+                     allocation.offset_);
 
   return VK_SUCCESS;
 }
 
 VkResult Buffer::CopyBuffer(Device* device, VkBuffer src, VkBuffer dst,
-                            VkDeviceSize size) {
+                            VkDeviceSize size, VkDeviceSize dst_offset) {
+  // queued uploads to src land first and belong to the graphics queue
+  // once flushed
+  VkResult result = device->uploader_.Flush();
+  if (result != VK_SUCCESS) return result;
   VkCommandBuffer command_buffer = device->BeginSingleTimeCommands();
   VkBufferCopy copy_region{};
   copy_region.srcOffset = 0;
-  copy_region.dstOffset = 0;
+  copy_region.dstOffset = dst_offset;
   copy_region.size = size;
   vkCmdCopyBuffer(command_buffer, src, dst, 1, &copy_region);
   device->EndSingleTimeCommands(command_buffer);
@@ -107,8 +106,7 @@ void Buffer::Destroy(VkDevice device) {
   if (buffer_ != VK_NULL_HANDLE) {
     vkDestroyBuffer(device, buffer_, nullptr);
   }
-  if (memory_ != VK_NULL_HANDLE) {
-    vkFreeMemory(device, memory_, nullptr);
-  }
+  buffer_ = VK_NULL_HANDLE;
+  if (allocator_) allocator_->Free(allocation_);
 };
 };  // namespace Rain
\ No newline at end of file
@@ -9,18 +9,25 @@ namespace Rain {
 class Buffer {
  public:
   VkBuffer buffer_ = VK_NULL_HANDLE;
-  VkDeviceMemory memory_ = VK_NULL_HANDLE;
+  Allocation allocation_;
+  MemoryAllocator* allocator_ = nullptr;
   VkDeviceSize size_;
   VkMemoryPropertyFlags properties_;
   VkResult Allocate(Device* device, const void* data, uint64_t size,
                     VkBufferUsageFlagBits usage_flags);
   VkResult AllocateDeviceLocal(Device* device, const void* data, uint64_t size,
                                VkBufferUsageFlagBits usage_flags);
+  // overwrite size bytes at offset, queued on device->uploader_ and done
+  // after its next Flush
+  VkResult Update(Device* device, const void* data, uint64_t size,
+                  VkDeviceSize offset = 0);
   static VkResult CreateBuffer(Device* device, uint64_t size,
                         VkBufferUsageFlagBits usage_flags,
                         VkMemoryPropertyFlags properties, VkBuffer& buffer,
-                        VkDeviceMemory& memory);
-  static VkResult CopyBuffer(Device* device, VkBuffer src, VkBuffer dst, VkDeviceSize size);
+                        Allocation& allocation);
+  // blocks until done
+  static VkResult CopyBuffer(Device* device, VkBuffer src, VkBuffer dst,
+                             VkDeviceSize size, VkDeviceSize dst_offset = 0);
   void Destroy(VkDevice device);
 };
 };  // namespace Rain
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "geometrypool.h"
+
+#include <algorithm>
+
+namespace Rain {
+void GeometryPool::Init(const std::vector<uint32_t>& strides,
+                        VkBufferUsageFlagBits usage) {
+  strides_ = strides;
+  // the old buffers are the copy source when growing
+  usage_ = static_cast<VkBufferUsageFlagBits>(
+      usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+  capacity_ = 0;
+}
+
+VkResult GeometryPool::Allocate(Device* device, uint64_t n,
+                                const std::vector<const void*>& data,
+                                uint64_t& first, uint32_t& node) {
+  VkResult result;
+  node = capacity_ ? ranges_.Allocate(n, 1, first) : RangeAllocator::NULL_NODE;
+  // the allocator looks for n rounded up to its size class, which a free
+  // tail of exactly n elements may not reach, the doubled capacity always
+  // leaves a tail of at least 2n
+  uint64_t capacity =
+      std::max({capacity_ * 2, capacity_ + n, uint64_t(MIN_CAPACITY)});
+  for (int i = 0; i < 2 && node == RangeAllocator::NULL_NODE; ++i) {
+    result = Grow(device, capacity);
+    if (result != VK_SUCCESS) return result;
+    node = ranges_.Allocate(n, 1, first);
+    capacity *= 2;
+  }
+  if (node == RangeAllocator::NULL_NODE) {
+    spdlog::error("geometry pool allocation of {} elements failed", n);
+    return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+  }
+  for (size_t i = 0; n && i < buffers_.size(); ++i) {
+    result = buffers_[i].Update(device, data[i], n * strides_[i],
+                                first * strides_[i]);
+    if (result != VK_SUCCESS) return result;
+  }
+  return VK_SUCCESS;
+}
+
+void GeometryPool::Free(uint32_t node) {
+  if (node != RangeAllocator::NULL_NODE) ranges_.Free(node);
+}
+
+VkResult GeometryPool::Grow(Device* device, uint64_t capacity) {
+  VkResult result;
+  std::vector<Buffer> buffers(strides_.size());
+  for (size_t i = 0; i < buffers.size(); ++i) {
+    result = buffers[i].AllocateDeviceLocal(device, nullptr,
+                                            capacity * strides_[i], usage_);
+    if (result != VK_SUCCESS) {
+      for (auto& buffer : buffers) buffer.Destroy(device->device_);
+      return result;
+    }
+    // the copy idles the graphics queue, so no frame reads the old buffer
+    // once it is destroyed
+    if (capacity_) {
+      result = Buffer::CopyBuffer(device, buffers_[i].buffer_,
+                                  buffers[i].buffer_, capacity_ * strides_[i]);
+      if (result != VK_SUCCESS) {
+        for (auto& buffer : buffers) buffer.Destroy(device->device_);
+        return result;
+      }
+    }
+  }
+  for (auto& buffer : buffers_) buffer.Destroy(device->device_);
+  buffers_ = buffers;
+  vkbuffers_.clear();
+  for (auto& buffer : buffers_) vkbuffers_.push_back(buffer.buffer_);
+  vkbuffer_offsets_.assign(buffers_.size(), 0);
+
+  if (capacity_) {
+    ranges_.Grow(capacity);
+  } else {
+    ranges_.Init(capacity);
+  }
+  spdlog::debug("geometry pool grown from {} to {} elements", capacity_,
+                capacity);
+  capacity_ = capacity;
+  return VK_SUCCESS;
+}
+
+void GeometryPool::Bind(VkCommandBuffer command_buffer) const {
+  if (usage_ & VK_BUFFER_USAGE_INDEX_BUFFER_BIT) {
+    vkCmdBindIndexBuffer(command_buffer, vkbuffers_[0], 0,
+                         strides_[0] == sizeof(uint16_t)
+                             ? VK_INDEX_TYPE_UINT16
+                             : VK_INDEX_TYPE_UINT32);
+  } else {
+    vkCmdBindVertexBuffers(command_buffer, 0, uint32_t(vkbuffers_.size()),
+                           vkbuffers_.data(), vkbuffer_offsets_.data());
+  }
+}
+
+void GeometryPool::Destroy(VkDevice device) {
+  for (auto& buffer : buffers_) buffer.Destroy(device);
+  buffers_.clear();
+  vkbuffers_.clear();
+  vkbuffer_offsets_.clear();
+  capacity_ = 0;
+}
+};  // namespace Rain
\ No newline at end of file
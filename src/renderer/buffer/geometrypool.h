@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+#include "buffer/buffer.h"
+#include "device/device.h"
+#include "memory/rangeallocator.h"
+
+namespace Rain {
+// Device local buffers shared by every mesh: one per attribute stream, and a
+// mesh owns the same element range in each of them. Ranges are counted in
+// elements, so the first element of a range is what vertexOffset or
+// firstIndex of a draw take. The buffers grow by copying when full.
+class GeometryPool {
+ public:
+  static const uint64_t MIN_CAPACITY = 1 << 20;
+
+  std::vector<uint32_t> strides_;  // bytes per element, per stream
+  VkBufferUsageFlagBits usage_;
+  std::vector<Buffer> buffers_;
+  std::vector<VkBuffer> vkbuffers_;
+  std::vector<VkDeviceSize> vkbuffer_offsets_;
+  RangeAllocator ranges_;
+  uint64_t capacity_ = 0;  // elements
+
+  void Init(const std::vector<uint32_t>& strides,
+            VkBufferUsageFlagBits usage);
+  // take n elements and upload data, one array per stream; node identifies
+  // the range for Free
+  VkResult Allocate(Device* device, uint64_t n,
+                    const std::vector<const void*>& data, uint64_t& first,
+                    uint32_t& node);
+  void Free(uint32_t node);
+  VkResult Grow(Device* device, uint64_t capacity);
+  void Bind(VkCommandBuffer command_buffer) const;
+  void Destroy(VkDevice device);
+};
+};  // namespace Rain
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include "uniformring.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Rain {
+VkResult UniformRing::Init(Device* device, uint32_t n_frame,
+                           VkDeviceSize frame_size) {
+  VkPhysicalDeviceProperties props;
+  vkGetPhysicalDeviceProperties(device->physical_device_, &props);
+  atom_size_ = props.limits.nonCoherentAtomSize;
+  n_frame_ = n_frame;
+  // frames start on an atom so flushing one never touches the other
+  frame_size_ = (frame_size + atom_size_ - 1) / atom_size_ * atom_size_;
+  frame_size_ = device->GetAlignedUniformByteOffset(uint32_t(frame_size_));
+  frame_size_ = device->GetAlignedStorageByteOffset(uint32_t(frame_size_));
+
+  // coherent memory is not required, the dirty ranges are flushed
+  buffer_.size_ = frame_size_ * n_frame_;
+  buffer_.allocator_ = &device->allocator_;
+  VkResult result = Buffer::CreateBuffer(
+      device, buffer_.size_,
+      VkBufferUsageFlagBits(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT),
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, buffer_.buffer_,
+      buffer_.allocation_);
+  if (result != VK_SUCCESS) return result;
+  uint32_t memory_type =
+      device->allocator_.pools_[buffer_.allocation_.pool_].memory_type_;
+  buffer_.properties_ =
+      device->physicalmem_properties_.memoryTypes[memory_type].propertyFlags;
+  coherent_ = buffer_.properties_ & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  dirty_.clear();
+  return VK_SUCCESS;
+}
+
+void UniformRing::Write(uint32_t frame, VkDeviceSize offset, const void* data,
+                        VkDeviceSize size) {
+  VkDeviceSize begin = GetOffset(frame, offset);
+  memcpy(static_cast<char*>(buffer_.allocation_.mapped_) + begin, data,
+         size_t(size));
+  if (coherent_) return;
+  // flush ranges are in the memory object and cover whole atoms
+  VkDeviceSize base = buffer_.allocation_.offset_;
+  VkDeviceSize atom_begin = (base + begin) / atom_size_ * atom_size_;
+  VkDeviceSize atom_end =
+      (base + begin + size + atom_size_ - 1) / atom_size_ * atom_size_;
+  if (!dirty_.empty() &&
+      dirty_.back().offset + dirty_.back().size + atom_size_ >= atom_begin &&
+      dirty_.back().offset <= atom_begin) {
+    VkMappedMemoryRange& range = dirty_.back();
+    range.size = std::max(range.offset + range.size, atom_end) - range.offset;
+    return;
+  }
+  VkMappedMemoryRange range{};
+  range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+  range.memory = buffer_.allocation_.memory_;
+  range.offset = atom_begin;
+  range.size = atom_end - atom_begin;
+  dirty_.push_back(range);
+}
+
+VkResult UniformRing::Flush(VkDevice device) {
+  if (dirty_.empty()) return VK_SUCCESS;
+  VkResult result = vkFlushMappedMemoryRanges(device, uint32_t(dirty_.size()),
+                                              dirty_.data());
+  dirty_.clear();
+  if (result != VK_SUCCESS) {
+    spdlog::error("uniform flush failed");
+    return result;
+  }
+  return VK_SUCCESS;
+}
+
+VkResult UniformRing::Read(VkDevice device, uint32_t frame,
+                           VkDeviceSize offset, void* data,
+                           VkDeviceSize size) {
+  VkDeviceSize begin = GetOffset(frame, offset);
+  if (!coherent_) {
+    VkDeviceSize base = buffer_.allocation_.offset_;
+    VkMappedMemoryRange range{};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = buffer_.allocation_.memory_;
+    range.offset = (base + begin) / atom_size_ * atom_size_;
+    range.size = (base + begin + size + atom_size_ - 1) / atom_size_ *
+                     atom_size_ -
+                 range.offset;
+    VkResult result = vkInvalidateMappedMemoryRanges(device, 1, &range);
+    if (result != VK_SUCCESS) {
+      spdlog::error("uniform invalidation failed");
+      return result;
+    }
+  }
+  memcpy(data, static_cast<char*>(buffer_.allocation_.mapped_) + begin,
+         size_t(size));
+  return VK_SUCCESS;
+}
+
+void UniformRing::Destroy(VkDevice device) {
+  buffer_.Destroy(device);
+  dirty_.clear();
+  frame_size_ = 0;
+}
+};  // namespace Rain
\ No newline at end of file
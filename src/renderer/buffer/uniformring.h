@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+#include "buffer/buffer.h"
+#include "device/device.h"
+
+namespace Rain {
+// Host visible uniform, storage and indirect buffer with one region per
+// frame in flight. A frame writes its region with plain stores through the
+// persistent mapping and shaders read slices of it through dynamic offsets,
+// so nothing is mapped, staged or rebound per frame. On non-coherent memory
+// only the ranges written since the last Flush are flushed.
+class UniformRing {
+ public:
+  Buffer buffer_;
+  uint32_t n_frame_ = 0;
+  VkDeviceSize frame_size_ = 0;
+  VkDeviceSize atom_size_ = 1;  // nonCoherentAtomSize
+  bool coherent_ = true;
+  // written since the last Flush, merged when close to each other
+  std::vector<VkMappedMemoryRange> dirty_;
+
+  VkResult Init(Device* device, uint32_t n_frame, VkDeviceSize frame_size);
+  // offset in the buffer of offset in the region of frame
+  VkDeviceSize GetOffset(uint32_t frame, VkDeviceSize offset) const {
+    return frame * frame_size_ + offset;
+  }
+  void Write(uint32_t frame, VkDeviceSize offset, const void* data,
+             VkDeviceSize size);
+  VkResult Flush(VkDevice device);
+  // copy out what the GPU wrote to the region of frame, once its fence is
+  // signaled
+  VkResult Read(VkDevice device, uint32_t frame, VkDeviceSize offset,
+                void* data, VkDeviceSize size);
+  void Destroy(VkDevice device);
+};
+};  // namespace Rain
\ No newline at end of file
@@ -80,6 +80,7 @@ void Camera::UpdateData() {
   }
   if (proj_dirty_ || view_dirty_) {
     proj_view_ = proj_ * view_;
+    Culling::ExtractPlanes(proj_view_, frustum_);
   }
   proj_dirty_ = false;
   view_dirty_ = false;
@@ -8,6 +8,7 @@
 #include "buffer/buffer.h"
 #include "device/device.h"
 #include "mathtype.h"
+#include "scene/culling.h"
 #include "surface/swapchain.h"
 
 namespace Rain {
@@ -38,6 +39,8 @@ class Camera {
   Mat4f view_;
 
   Mat4f proj_view_;
+  // inside half spaces of proj_view_, see Culling::ExtractPlanes
+  Vec4f frustum_[6];
 
   // VkResult CreateBuffer(Device* device, SwapChain* swap_chain);
   void InitData(const float aspect, const float fovy, const float z_near,
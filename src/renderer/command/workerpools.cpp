@@ -0,0 +1,72 @@
+#include "workerpools.h"
+
+#include "spdlog/spdlog.h"
+
+namespace Rain {
+VkResult WorkerCommandPools::Init(Device* device, uint32_t n_frame,
+                                  uint32_t n_worker) {
+  n_frame_ = n_frame;
+  n_worker_ = n_worker;
+  pools_.resize(n_frame_ * n_worker_);
+  VkCommandPoolCreateInfo pool_info{};
+  pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  pool_info.queueFamilyIndex = device->graphics_queue_family_;
+  // the buffers are reset with their pool when the draws change
+  pool_info.flags = 0;
+  for (WorkerPool& pool : pools_) {
+    VkResult result =
+        vkCreateCommandPool(device->device_, &pool_info, nullptr, &pool.pool_);
+    if (result != VK_SUCCESS) {
+      spdlog::error("worker command pool creation failed");
+      return result;
+    }
+  }
+  return VK_SUCCESS;
+}
+
+VkResult WorkerCommandPools::Reset(VkDevice device, uint32_t frame) {
+  for (uint32_t worker = 0; worker < n_worker_; ++worker) {
+    WorkerPool& pool = pools_[frame * n_worker_ + worker];
+    if (pool.n_used_ == 0) continue;
+    VkResult result = vkResetCommandPool(device, pool.pool_, 0);
+    if (result != VK_SUCCESS) {
+      spdlog::error("worker command pool reset failed");
+      return result;
+    }
+    pool.n_used_ = 0;
+  }
+  return VK_SUCCESS;
+}
+
+VkResult WorkerCommandPools::Allocate(VkDevice device, uint32_t frame,
+                                      uint32_t worker,
+                                      VkCommandBuffer& command_buffer) {
+  WorkerPool& pool = pools_[frame * n_worker_ + worker];
+  if (pool.n_used_ == pool.buffers_.size()) {
+    VkCommandBufferAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.commandPool = pool.pool_;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    alloc_info.commandBufferCount = 1;
+    VkCommandBuffer buffer;
+    VkResult result = vkAllocateCommandBuffers(device, &alloc_info, &buffer);
+    if (result != VK_SUCCESS) {
+      spdlog::error("secondary command buffer allocation failed");
+      return result;
+    }
+    pool.buffers_.push_back(buffer);
+  }
+  command_buffer = pool.buffers_[pool.n_used_++];
+  return VK_SUCCESS;
+}
+
+void WorkerCommandPools::Destroy(VkDevice device) {
+  // destroying a pool frees its buffers
+  for (WorkerPool& pool : pools_) {
+    if (pool.pool_ != VK_NULL_HANDLE) {
+      vkDestroyCommandPool(device, pool.pool_, nullptr);
+    }
+  }
+  pools_.clear();
+}
+};  // namespace Rain
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+#include "device/device.h"
+
+namespace Rain {
+// Command pools of the threads recording secondary command buffers. A pool
+// is only used from one thread at a time, so there is one per worker of
+// ThreadPool::Global() and per frame in flight. The buffers of a frame are
+// recycled by resetting its pools once the fence of the frame is signaled,
+// until then they can be executed again.
+class WorkerCommandPools {
+ public:
+  struct WorkerPool {
+    VkCommandPool pool_ = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> buffers_;
+    uint32_t n_used_ = 0;  // handed out since the last reset
+  };
+
+  uint32_t n_frame_ = 0;
+  uint32_t n_worker_ = 0;
+  std::vector<WorkerPool> pools_;  // n_worker_ per frame
+
+  VkResult Init(Device* device, uint32_t n_frame, uint32_t n_worker);
+  // before the buffers of frame are recorded again
+  VkResult Reset(VkDevice device, uint32_t frame);
+  // a secondary buffer of frame, to be recorded from worker only
+  VkResult Allocate(VkDevice device, uint32_t frame, uint32_t worker,
+                    VkCommandBuffer& command_buffer);
+  void Destroy(VkDevice device);
+};
+};  // namespace Rain
\ No newline at end of file
@@ -0,0 +1,548 @@
+#include "gpuculler.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+
+#include "shader/shader.h"
+
+namespace Rain {
+namespace {
+// src and dst sizes of the level being built
+struct PyramidPushConstants {
+  int32_t src_size_[2];
+  int32_t dst_size_[2];
+};
+
+// constant_id 0 and 1 of cull.comp
+struct CullSpecialization {
+  uint32_t pass_;
+  VkBool32 compact_;
+};
+
+void Barrier(VkCommandBuffer command_buffer, VkPipelineStageFlags src_stage,
+             VkAccessFlags src_access, VkPipelineStageFlags dst_stage,
+             VkAccessFlags dst_access) {
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = src_access;
+  barrier.dstAccessMask = dst_access;
+  vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 1, &barrier, 0,
+                       nullptr, 0, nullptr);
+}
+}  // namespace
+
+VkResult GpuCuller::Init(Device* device, uint32_t n_frame) {
+  VkResult result;
+  VkPhysicalDeviceProperties props;
+  vkGetPhysicalDeviceProperties(device->physical_device_, &props);
+  if (props.limits.maxPerStageDescriptorStorageBuffers < 5) {
+    spdlog::warn("GPU culling unavailable, {} storage buffers per stage",
+                 props.limits.maxPerStageDescriptorStorageBuffers);
+    return VK_SUCCESS;
+  }
+  Shader cull_shader, pyramid_shader;
+  result = cull_shader.Init(device->device_, "cull");
+  if (result != VK_SUCCESS) return result;
+  result = pyramid_shader.Init(device->device_, "pyramid");
+  if (result != VK_SUCCESS) {
+    cull_shader.Destroy(device->device_);
+    return result;
+  }
+  VkShaderModule cull_module =
+      cull_shader.modules_[Shader::SHADER_STAGE_COMPUTE];
+  VkShaderModule pyramid_module =
+      pyramid_shader.modules_[Shader::SHADER_STAGE_COMPUTE];
+  if (cull_module == VK_NULL_HANDLE || pyramid_module == VK_NULL_HANDLE) {
+    spdlog::warn("GPU culling unavailable, compute shaders not found");
+    cull_shader.Destroy(device->device_);
+    pyramid_shader.Destroy(device->device_);
+    return VK_SUCCESS;
+  }
+  compact_ = device->draw_indexed_indirect_count_ != nullptr;
+
+  {  // culling set, one per frame region
+    VkDescriptorSetLayoutBinding bindings[BINDING_NUM]{};
+    for (uint32_t i = 0; i < BINDING_NUM; ++i) {
+      bindings[i].binding = i;
+      bindings[i].descriptorCount = 1;
+      bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    bindings[BINDING_CULL_DATA].descriptorType =
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    bindings[BINDING_PYRAMID].descriptorType =
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    VkDescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = BINDING_NUM;
+    layout_info.pBindings = bindings;
+    result = vkCreateDescriptorSetLayout(device->device_, &layout_info,
+                                         nullptr, &layout_);
+    if (result != VK_SUCCESS) {
+      spdlog::error("culling set layout creation failed");
+      return result;
+    }
+
+    VkDescriptorPoolSize pool_sizes[3];
+    pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    pool_sizes[0].descriptorCount = n_frame;
+    pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    pool_sizes[1].descriptorCount = (BINDING_NUM - 2) * n_frame;
+    pool_sizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    pool_sizes[2].descriptorCount = n_frame;
+    VkDescriptorPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.poolSizeCount = 3;
+    pool_info.pPoolSizes = pool_sizes;
+    pool_info.maxSets = n_frame;
+    result =
+        vkCreateDescriptorPool(device->device_, &pool_info, nullptr, &pool_);
+    if (result != VK_SUCCESS) {
+      spdlog::error("culling descriptor pool creation failed");
+      return result;
+    }
+    std::vector<VkDescriptorSetLayout> layouts(n_frame, layout_);
+    VkDescriptorSetAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = pool_;
+    alloc_info.descriptorSetCount = n_frame;
+    alloc_info.pSetLayouts = layouts.data();
+    sets_.resize(n_frame);
+    result = vkAllocateDescriptorSets(device->device_, &alloc_info,
+                                      sets_.data());
+    if (result != VK_SUCCESS) {
+      spdlog::error("culling descriptor sets allocation failed");
+      return result;
+    }
+  }
+
+  {  // pyramid level set, the source level sampled and the next one stored
+    VkDescriptorSetLayoutBinding bindings[2]{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorCount = 1;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorCount = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    VkDescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = 2;
+    layout_info.pBindings = bindings;
+    result = vkCreateDescriptorSetLayout(device->device_, &layout_info,
+                                         nullptr, &pyramid_layout_);
+    if (result != VK_SUCCESS) {
+      spdlog::error("pyramid set layout creation failed");
+      return result;
+    }
+  }
+
+  {  // texelFetch only, the sampler is never filtering
+    VkSamplerCreateInfo sampler_info{};
+    sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_info.magFilter = VK_FILTER_NEAREST;
+    sampler_info.minFilter = VK_FILTER_NEAREST;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+    result =
+        vkCreateSampler(device->device_, &sampler_info, nullptr, &sampler_);
+    if (result != VK_SUCCESS) {
+      spdlog::error("pyramid sampler creation failed");
+      return result;
+    }
+  }
+
+  {  // pipelines
+    VkPipelineLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &layout_;
+    result = vkCreatePipelineLayout(device->device_, &layout_info, nullptr,
+                                    &pipeline_layout_);
+    if (result != VK_SUCCESS) {
+      spdlog::error("culling pipeline layout creation failed");
+      return result;
+    }
+    VkPushConstantRange push_constant{};
+    push_constant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_constant.offset = 0;
+    push_constant.size = sizeof(PyramidPushConstants);
+    layout_info.pSetLayouts = &pyramid_layout_;
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_constant;
+    result = vkCreatePipelineLayout(device->device_, &layout_info, nullptr,
+                                    &pyramid_pipeline_layout_);
+    if (result != VK_SUCCESS) {
+      spdlog::error("pyramid pipeline layout creation failed");
+      return result;
+    }
+
+    VkSpecializationMapEntry entries[2]{};
+    entries[0].constantID = 0;
+    entries[0].offset = offsetof(CullSpecialization, pass_);
+    entries[0].size = sizeof(uint32_t);
+    entries[1].constantID = 1;
+    entries[1].offset = offsetof(CullSpecialization, compact_);
+    entries[1].size = sizeof(VkBool32);
+    CullSpecialization constants[2] = {{0, compact_}, {1, compact_}};
+    VkSpecializationInfo specialization_infos[2]{};
+    VkComputePipelineCreateInfo pipeline_infos[3]{};
+    for (int pass = 0; pass < 2; ++pass) {
+      specialization_infos[pass].mapEntryCount = 2;
+      specialization_infos[pass].pMapEntries = entries;
+      specialization_infos[pass].dataSize = sizeof(CullSpecialization);
+      specialization_infos[pass].pData = &constants[pass];
+      VkComputePipelineCreateInfo& info = pipeline_infos[pass];
+      info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+      info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+      info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+      info.stage.module = cull_module;
+      info.stage.pName = "main";
+      info.stage.pSpecializationInfo = &specialization_infos[pass];
+      info.layout = pipeline_layout_;
+    }
+    VkComputePipelineCreateInfo& info = pipeline_infos[2];
+    info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    info.stage.module = pyramid_module;
+    info.stage.pName = "main";
+    info.layout = pyramid_pipeline_layout_;
+    VkPipeline pipelines[3];
+    auto start = std::chrono::steady_clock::now();
+    result = vkCreateComputePipelines(device->device_, device->pipeline_cache_,
+                                      3, pipeline_infos, nullptr, pipelines);
+    cull_shader.Destroy(device->device_);
+    pyramid_shader.Destroy(device->device_);
+    if (result != VK_SUCCESS) {
+      spdlog::error("culling pipeline creation failed");
+      return result;
+    }
+    std::chrono::duration<double, std::milli> time =
+        std::chrono::steady_clock::now() - start;
+    spdlog::info("3 culling pipelines created in {:.2f} ms", time.count());
+    pipelines_[0] = pipelines[0];
+    pipelines_[1] = pipelines[1];
+    pyramid_pipeline_ = pipelines[2];
+  }
+
+  supported_ = true;
+  return VK_SUCCESS;
+}
+
+void GpuCuller::UpdateDescriptor(VkDevice device, uint32_t frame,
+                                 const VkDescriptorBufferInfo* buffers) {
+  if (!supported_) return;
+  VkWriteDescriptorSet writes[BINDING_PYRAMID]{};
+  for (uint32_t i = 0; i < BINDING_PYRAMID; ++i) {
+    writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].dstSet = sets_[frame];
+    writes[i].dstBinding = i;
+    writes[i].descriptorCount = 1;
+    writes[i].descriptorType = i == BINDING_CULL_DATA
+                                   ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+                                   : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[i].pBufferInfo = &buffers[i];
+  }
+  vkUpdateDescriptorSets(device, BINDING_PYRAMID, writes, 0, nullptr);
+}
+
+VkResult GpuCuller::InitPyramid(Device* device,
+                                const std::vector<Image*>& depth_images) {
+  if (!supported_) return VK_SUCCESS;
+  VkResult result;
+  depth_images_ = depth_images;
+  pyramid_valid_ = false;
+  const Image& depth = *depth_images_[0];
+  // power of two levels so that a texel of level l always covers the
+  // 2^(l+1) depth pixels from its index shifted left by l+1
+  uint32_t width = 1, height = 1;
+  while (2 * width < depth.width_) width *= 2;
+  while (2 * height < depth.height_) height *= 2;
+  uint32_t n_level = 1;
+  while ((std::max(width, height) >> (n_level - 1)) > 1) ++n_level;
+  result = pyramid_.InitStorageImage(device, VK_FORMAT_R32_SFLOAT, width,
+                                     height, n_level);
+  if (result != VK_SUCCESS) {
+    spdlog::error("depth pyramid creation failed");
+    return result;
+  }
+  level_views_.resize(n_level);
+  for (uint32_t level = 0; level < n_level; ++level) {
+    VkImageViewCreateInfo view_info{};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.image = pyramid_.image_;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = pyramid_.format_;
+    view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    view_info.subresourceRange.baseMipLevel = level;
+    view_info.subresourceRange.levelCount = 1;
+    view_info.subresourceRange.baseArrayLayer = 0;
+    view_info.subresourceRange.layerCount = 1;
+    result = vkCreateImageView(device->device_, &view_info, nullptr,
+                               &level_views_[level]);
+    if (result != VK_SUCCESS) {
+      spdlog::error("image view creation failed");
+      return result;
+    }
+  }
+
+  {  // general layout for good, written and sampled by compute shaders
+    VkCommandBuffer command_buffer = device->BeginSingleTimeCommands();
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = pyramid_.image_;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = n_level;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.dstAccessMask =
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr,
+                         0, nullptr, 1, &barrier);
+    device->EndSingleTimeCommands(command_buffer);
+    pyramid_.layout_ = VK_IMAGE_LAYOUT_GENERAL;
+  }
+
+  // every level but the last is the source of the next one
+  uint32_t n_set = uint32_t(depth_images_.size()) + n_level - 1;
+  VkDescriptorPoolSize pool_sizes[2];
+  pool_sizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  pool_sizes[0].descriptorCount = n_set;
+  pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  pool_sizes[1].descriptorCount = n_set;
+  VkDescriptorPoolCreateInfo pool_info{};
+  pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pool_info.poolSizeCount = 2;
+  pool_info.pPoolSizes = pool_sizes;
+  pool_info.maxSets = n_set;
+  result = vkCreateDescriptorPool(device->device_, &pool_info, nullptr,
+                                  &pyramid_pool_);
+  if (result != VK_SUCCESS) {
+    spdlog::error("pyramid descriptor pool creation failed");
+    return result;
+  }
+  std::vector<VkDescriptorSetLayout> layouts(n_set, pyramid_layout_);
+  std::vector<VkDescriptorSet> sets(n_set);
+  VkDescriptorSetAllocateInfo alloc_info{};
+  alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  alloc_info.descriptorPool = pyramid_pool_;
+  alloc_info.descriptorSetCount = n_set;
+  alloc_info.pSetLayouts = layouts.data();
+  result = vkAllocateDescriptorSets(device->device_, &alloc_info, sets.data());
+  if (result != VK_SUCCESS) {
+    spdlog::error("pyramid descriptor sets allocation failed");
+    return result;
+  }
+  depth_sets_.assign(sets.begin(), sets.begin() + depth_images_.size());
+  level_sets_.assign(sets.begin() + depth_images_.size(), sets.end());
+
+  std::vector<VkDescriptorImageInfo> src_infos(n_set), dst_infos(n_set);
+  std::vector<VkWriteDescriptorSet> writes;
+  for (uint32_t i = 0; i < n_set; ++i) {
+    bool from_depth = i < depth_images_.size();
+    uint32_t level = from_depth ? 0 : i - uint32_t(depth_images_.size()) + 1;
+    src_infos[i].sampler = sampler_;
+    src_infos[i].imageView =
+        from_depth ? depth_images_[i]->view_ : level_views_[level - 1];
+    src_infos[i].imageLayout = from_depth
+                                   ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                                   : VK_IMAGE_LAYOUT_GENERAL;
+    dst_infos[i].imageView = level_views_[level];
+    dst_infos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    // depth images without the sampled usage are never read
+    if (!from_depth || (depth_images_[i]->usages_ & VK_IMAGE_USAGE_SAMPLED_BIT)) {
+      VkWriteDescriptorSet write{};
+      write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      write.dstSet = sets[i];
+      write.dstBinding = 0;
+      write.descriptorCount = 1;
+      write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+      write.pImageInfo = &src_infos[i];
+      writes.push_back(write);
+    }
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = sets[i];
+    write.dstBinding = 1;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    write.pImageInfo = &dst_infos[i];
+    writes.push_back(write);
+  }
+  // the culling sets sample every level
+  VkDescriptorImageInfo pyramid_info{};
+  pyramid_info.sampler = sampler_;
+  pyramid_info.imageView = pyramid_.view_;
+  pyramid_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+  for (VkDescriptorSet set : sets_) {
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = set;
+    write.dstBinding = BINDING_PYRAMID;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &pyramid_info;
+    writes.push_back(write);
+  }
+  vkUpdateDescriptorSets(device->device_, uint32_t(writes.size()),
+                         writes.data(), 0, nullptr);
+  return VK_SUCCESS;
+}
+
+void GpuCuller::DestroyPyramid(VkDevice device) {
+  if (pyramid_pool_ != VK_NULL_HANDLE) {
+    vkDestroyDescriptorPool(device, pyramid_pool_, nullptr);
+    pyramid_pool_ = VK_NULL_HANDLE;
+  }
+  depth_sets_.clear();
+  level_sets_.clear();
+  for (VkImageView view : level_views_) {
+    if (view != VK_NULL_HANDLE) vkDestroyImageView(device, view, nullptr);
+  }
+  level_views_.clear();
+  if (pyramid_.image_ != VK_NULL_HANDLE) pyramid_.Destroy(device);
+  depth_images_.clear();
+  pyramid_valid_ = false;
+}
+
+void GpuCuller::RecordCulling(VkCommandBuffer command_buffer, uint32_t frame,
+                              uint32_t n_instance, uint32_t n_template) {
+  if (n_instance == 0 || n_template == 0) return;
+  // the pyramid built at the end of the previous frame
+  Barrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+          VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+          VK_ACCESS_SHADER_READ_BIT);
+  vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          pipeline_layout_, 0, 1, &sets_[frame], 0, nullptr);
+  vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    pipelines_[0]);
+  vkCmdDispatch(command_buffer, (n_instance + GROUP_SIZE - 1) / GROUP_SIZE, 1,
+                1);
+  // the visible counts of the ranges are final
+  Barrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+          VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+          VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+  vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    pipelines_[1]);
+  vkCmdDispatch(command_buffer, (n_template + GROUP_SIZE - 1) / GROUP_SIZE, 1,
+                1);
+  // commands and counts for the draws, draw slots for the vertex shader and
+  // the counters for RenderScene once the frame fence is signaled
+  Barrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+          VK_ACCESS_SHADER_WRITE_BIT,
+          VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+              VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+              VK_PIPELINE_STAGE_HOST_BIT,
+          VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT |
+              VK_ACCESS_HOST_READ_BIT);
+}
+
+void GpuCuller::RecordPyramid(VkCommandBuffer command_buffer,
+                              uint32_t image_index, const Mat4f& proj_view) {
+  const Image& depth = *depth_images_[image_index];
+  if (!(depth.usages_ & VK_IMAGE_USAGE_SAMPLED_BIT)) return;
+  // depth writes done, and the culling of this frame done with the pyramid
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = depth.image_;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+  if (depth.format_ == VK_FORMAT_D32_SFLOAT_S8_UINT ||
+      depth.format_ == VK_FORMAT_D24_UNORM_S8_UINT) {
+    barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+  }
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.layerCount = 1;
+  barrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(command_buffer,
+                       VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+  vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    pyramid_pipeline_);
+  PyramidPushConstants sizes;
+  sizes.src_size_[0] = int32_t(depth.width_);
+  sizes.src_size_[1] = int32_t(depth.height_);
+  for (uint32_t level = 0; level < pyramid_.mip_levels_; ++level) {
+    sizes.dst_size_[0] = int32_t(std::max(pyramid_.width_ >> level, 1u));
+    sizes.dst_size_[1] = int32_t(std::max(pyramid_.height_ >> level, 1u));
+    VkDescriptorSet set =
+        level == 0 ? depth_sets_[image_index] : level_sets_[level - 1];
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            pyramid_pipeline_layout_, 0, 1, &set, 0, nullptr);
+    vkCmdPushConstants(command_buffer, pyramid_pipeline_layout_,
+                       VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(sizes), &sizes);
+    vkCmdDispatch(
+        command_buffer,
+        (uint32_t(sizes.dst_size_[0]) + PYRAMID_GROUP_SIZE - 1) /
+            PYRAMID_GROUP_SIZE,
+        (uint32_t(sizes.dst_size_[1]) + PYRAMID_GROUP_SIZE - 1) /
+            PYRAMID_GROUP_SIZE,
+        1);
+    Barrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_ACCESS_SHADER_READ_BIT);
+    sizes.src_size_[0] = sizes.dst_size_[0];
+    sizes.src_size_[1] = sizes.dst_size_[1];
+  }
+  pyramid_proj_view_ = proj_view;
+  pyramid_valid_ = true;
+}
+
+void GpuCuller::Destroy(VkDevice device) {
+  DestroyPyramid(device);
+  for (auto& pipeline : pipelines_) {
+    if (pipeline != VK_NULL_HANDLE) {
+      vkDestroyPipeline(device, pipeline, nullptr);
+      pipeline = VK_NULL_HANDLE;
+    }
+  }
+  if (pyramid_pipeline_ != VK_NULL_HANDLE) {
+    vkDestroyPipeline(device, pyramid_pipeline_, nullptr);
+    pyramid_pipeline_ = VK_NULL_HANDLE;
+  }
+  if (pipeline_layout_ != VK_NULL_HANDLE) {
+    vkDestroyPipelineLayout(device, pipeline_layout_, nullptr);
+    pipeline_layout_ = VK_NULL_HANDLE;
+  }
+  if (pyramid_pipeline_layout_ != VK_NULL_HANDLE) {
+    vkDestroyPipelineLayout(device, pyramid_pipeline_layout_, nullptr);
+    pyramid_pipeline_layout_ = VK_NULL_HANDLE;
+  }
+  if (sampler_ != VK_NULL_HANDLE) {
+    vkDestroySampler(device, sampler_, nullptr);
+    sampler_ = VK_NULL_HANDLE;
+  }
+  if (pool_ != VK_NULL_HANDLE) {
+    vkDestroyDescriptorPool(device, pool_, nullptr);
+    pool_ = VK_NULL_HANDLE;
+  }
+  sets_.clear();
+  if (layout_ != VK_NULL_HANDLE) {
+    vkDestroyDescriptorSetLayout(device, layout_, nullptr);
+    layout_ = VK_NULL_HANDLE;
+  }
+  if (pyramid_layout_ != VK_NULL_HANDLE) {
+    vkDestroyDescriptorSetLayout(device, pyramid_layout_, nullptr);
+    pyramid_layout_ = VK_NULL_HANDLE;
+  }
+  supported_ = false;
+}
+};  // namespace Rain
\ No newline at end of file
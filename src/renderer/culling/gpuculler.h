@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+#include "device/device.h"
+#include "image/image.h"
+#include "mathtype.h"
+
+namespace Rain {
+// Culling of the instances in compute shaders. The first pass tests every
+// instance slot against the frustum and against a max depth pyramid of the
+// previous frame, and appends the material slots of the visible ones to the
+// draw slots of their draw ranges. The second one turns the draw templates
+// with visible instances into indirect commands, compacted in front of a
+// draw count per batch when VK_KHR_draw_indirect_count is enabled and with
+// instanceCount 0 for the culled ones otherwise. Every buffer is an area of
+// the frame region of RenderScene::uniform_ring_.
+class GpuCuller {
+ public:
+  // bindings of the culling set, as in cull.comp
+  enum Binding {
+    BINDING_CULL_DATA = 0,  // CullUniformData
+    BINDING_INSTANCES,      // InstanceData
+    BINDING_STATE,          // CullState then RangeData
+    BINDING_TEMPLATES,      // DrawTemplate
+    BINDING_DRAW_SLOTS,
+    BINDING_COMMANDS,  // VkDrawIndexedIndirectCommand
+    BINDING_PYRAMID,
+    BINDING_NUM,
+  };
+  static const uint32_t GROUP_SIZE = 64;  // local_size_x of cull.comp
+  static const uint32_t PYRAMID_GROUP_SIZE = 8;
+
+  // shaders found and enough storage buffers per stage
+  bool supported_ = false;
+  // commands compacted in front of draw counts
+  bool compact_ = false;
+  VkDescriptorSetLayout layout_ = VK_NULL_HANDLE;
+  VkDescriptorPool pool_ = VK_NULL_HANDLE;
+  std::vector<VkDescriptorSet> sets_;  // per frame in flight
+  VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
+  VkPipeline pipelines_[2] = {};  // instance pass, command pass
+
+  // farthest depth of 2x2 texels per level, level 0 covering the depth
+  // buffer at half resolution with power of two sizes
+  Image pyramid_;
+  std::vector<VkImageView> level_views_;
+  VkSampler sampler_ = VK_NULL_HANDLE;
+  VkDescriptorSetLayout pyramid_layout_ = VK_NULL_HANDLE;
+  VkDescriptorPool pyramid_pool_ = VK_NULL_HANDLE;
+  // level 0 from the depth image of each framebuffer, then one per level
+  std::vector<VkDescriptorSet> depth_sets_;
+  std::vector<VkDescriptorSet> level_sets_;
+  VkPipelineLayout pyramid_pipeline_layout_ = VK_NULL_HANDLE;
+  VkPipeline pyramid_pipeline_ = VK_NULL_HANDLE;
+  std::vector<Image*> depth_images_;
+  // the pyramid holds the depth seen through pyramid_proj_view_
+  bool pyramid_valid_ = false;
+  Mat4f pyramid_proj_view_ = Mat4f::Identity();
+
+  VkResult Init(Device* device, uint32_t n_frame);
+  // the buffer areas of the set of frame, BINDING_PYRAMID excluded
+  void UpdateDescriptor(VkDevice device, uint32_t frame,
+                        const VkDescriptorBufferInfo* buffers);
+  // for the depth images of the framebuffers, whenever they are recreated;
+  // without sampled depth the pyramid stays empty and nothing is occluded
+  VkResult InitPyramid(Device* device, const std::vector<Image*>& depth_images);
+  void DestroyPyramid(VkDevice device);
+  // both passes, ahead of the render pass drawing the commands
+  void RecordCulling(VkCommandBuffer command_buffer, uint32_t frame,
+                     uint32_t n_instance, uint32_t n_template);
+  // after the render pass writing depth_images_[image_index]
+  void RecordPyramid(VkCommandBuffer command_buffer, uint32_t image_index,
+                     const Mat4f& proj_view);
+  void Destroy(VkDevice device);
+};
+};  // namespace Rain
\ No newline at end of file
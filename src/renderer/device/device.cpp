@@ -1,35 +1,71 @@
 #include "device.h"
 
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <set>
 
+#include "helper/io.h"
 #include "spdlog/spdlog.h"
 
 namespace Rain {
+namespace {
+// what the data of every pipeline cache starts with
+struct PipelineCacheHeader {
+  uint32_t size_;
+  uint32_t version_;
+  uint32_t vendor_id_;
+  uint32_t device_id_;
+  uint8_t uuid_[VK_UUID_SIZE];
+};
+
+uint32_t AlignUp(uint32_t offset, uint32_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+}  // namespace
+
 VkResult Device::Init(VkPhysicalDevice physical_device,
                       uint32_t graphics_queue_family_index,
                       uint32_t present_queue_family_index,
+                      uint32_t transfer_queue_family_index,
                       const std::vector<const char*>* layers,
                       const std::vector<const char*>* extensions) {
   physical_device_ = physical_device;
   vkGetPhysicalDeviceMemoryProperties(physical_device,
                                       &physicalmem_properties_);
+  VkPhysicalDeviceProperties props;
+  vkGetPhysicalDeviceProperties(physical_device, &props);
+  uniform_alignment_ = uint32_t(props.limits.minUniformBufferOffsetAlignment);
+  storage_alignment_ = uint32_t(props.limits.minStorageBufferOffsetAlignment);
   spdlog::debug("queue family {} picked for graphics",
                 graphics_queue_family_index);
   spdlog::debug("queue family {} picked for present",
                 present_queue_family_index);
+  spdlog::debug("queue family {} picked for transfer",
+                transfer_queue_family_index);
+  graphics_queue_family_ = graphics_queue_family_index;
+  transfer_queue_family_ = transfer_queue_family_index;
   std::set<uint32_t> unique_queue_families = {graphics_queue_family_index,
-                                              present_queue_family_index};
+                                              present_queue_family_index,
+                                              transfer_queue_family_index};
   std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
   float queue_priority = 1.0f;
   for (uint32_t queue_family : unique_queue_families) {
     VkDeviceQueueCreateInfo queue_create_info{};
     queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    queue_create_info.queueFamilyIndex = graphics_queue_family_index;
+    queue_create_info.queueFamilyIndex = queue_family;
     queue_create_info.queueCount = 1;
     queue_create_info.pQueuePriorities = &queue_priority;
     queue_create_infos.push_back(queue_create_info);
   }
+  VkPhysicalDeviceFeatures supported_features;
+  vkGetPhysicalDeviceFeatures(physical_device, &supported_features);
   VkPhysicalDeviceFeatures device_features{};
+  // indirect draws of many commands carrying their material slot
+  device_features.multiDrawIndirect = supported_features.multiDrawIndirect;
+  device_features.drawIndirectFirstInstance =
+      supported_features.drawIndirectFirstInstance;
+  features_ = device_features;
 
   VkDeviceCreateInfo create_info{};
   create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -54,6 +90,17 @@ VkResult Device::Init(VkPhysicalDevice physical_device,
   if (result == VK_SUCCESS) {
     vkGetDeviceQueue(device_, graphics_queue_family_index, 0, &graphics_queue_);
     vkGetDeviceQueue(device_, present_queue_family_index, 0, &present_queue_);
+    vkGetDeviceQueue(device_, transfer_queue_family_index, 0, &transfer_queue_);
+    allocator_.Init(device_, physicalmem_properties_);
+    for (size_t i = 0; extensions && i < extensions->size(); ++i) {
+      if (strcmp((*extensions)[i],
+                 VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0) {
+        draw_indexed_indirect_count_ =
+            reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+                vkGetDeviceProcAddr(device_,
+                                    "vkCmdDrawIndexedIndirectCountKHR"));
+      }
+    }
   } else {
     spdlog::error("logical device creation failed");
     return result;
@@ -73,6 +120,18 @@ VkResult Device::Init(VkPhysicalDevice physical_device,
       spdlog::debug("command pool created");
     }
   }
+  result = InitPipelineCache();
+  if (result != VK_SUCCESS) {
+    spdlog::error("pipeline cache creation failed");
+    return result;
+  }
+  result = uploader_.Init(device_, transfer_queue_family_index, transfer_queue_,
+                          graphics_queue_family_index, graphics_queue_,
+                          &allocator_);
+  if (result != VK_SUCCESS) {
+    spdlog::error("uploader creation failed");
+    return result;
+  }
   return VK_SUCCESS;
 }
 
@@ -95,6 +154,91 @@ VkResult Device::AllocateCommandBuffers(SwapChain* swap_chain) {
   return VK_SUCCESS;
 }
 
+VkResult Device::InitPipelineCache() {
+  VkPhysicalDeviceProperties props;
+  vkGetPhysicalDeviceProperties(physical_device_, &props);
+  std::vector<char> data = IO::ReadFile(pipeline_cache_file_);
+  // the data of another device or driver is dropped here, not every driver
+  // checks it
+  if (!data.empty()) {
+    PipelineCacheHeader header{};
+    if (data.size() >= sizeof(PipelineCacheHeader)) {
+      memcpy(&header, data.data(), sizeof(PipelineCacheHeader));
+    }
+    if (header.size_ < sizeof(PipelineCacheHeader) ||
+        header.version_ != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+        header.vendor_id_ != props.vendorID ||
+        header.device_id_ != props.deviceID ||
+        memcmp(header.uuid_, props.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+      spdlog::info("{} is from another device or driver, ignored",
+                   pipeline_cache_file_);
+      data.clear();
+    }
+  }
+  VkPipelineCacheCreateInfo cache_info{};
+  cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cache_info.initialDataSize = data.size();
+  cache_info.pInitialData = data.empty() ? nullptr : data.data();
+  VkResult result =
+      vkCreatePipelineCache(device_, &cache_info, nullptr, &pipeline_cache_);
+  if (result != VK_SUCCESS && !data.empty()) {
+    // a matching header over broken data, start empty
+    spdlog::warn("{} rejected by the driver", pipeline_cache_file_);
+    data.clear();
+    cache_info.initialDataSize = 0;
+    cache_info.pInitialData = nullptr;
+    result =
+        vkCreatePipelineCache(device_, &cache_info, nullptr, &pipeline_cache_);
+  }
+  if (result != VK_SUCCESS) return result;
+  if (data.empty()) {
+    spdlog::info("pipeline cache empty");
+  } else {
+    spdlog::info("pipeline cache loaded from {}, {} KB", pipeline_cache_file_,
+                 data.size() >> 10);
+  }
+  return VK_SUCCESS;
+}
+
+void Device::SavePipelineCache() {
+  if (pipeline_cache_ == VK_NULL_HANDLE) return;
+  size_t size = 0;
+  if (vkGetPipelineCacheData(device_, pipeline_cache_, &size, nullptr) !=
+          VK_SUCCESS ||
+      size == 0) {
+    return;
+  }
+  std::vector<char> data(size);
+  if (vkGetPipelineCacheData(device_, pipeline_cache_, &size, data.data()) !=
+      VK_SUCCESS) {
+    spdlog::warn("pipeline cache data retrieval failed");
+    return;
+  }
+  // write aside and rename, a crash never leaves half a cache behind
+  std::string tmp_file = pipeline_cache_file_ + ".tmp";
+  {
+    std::ofstream file(tmp_file, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      spdlog::warn("{} can not be written", tmp_file);
+      return;
+    }
+    file.write(data.data(), size);
+    if (!file.good()) {
+      spdlog::warn("{} write failed", tmp_file);
+      return;
+    }
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmp_file, pipeline_cache_file_, ec);
+  if (ec) {
+    spdlog::warn("{} can not be replaced: {}", pipeline_cache_file_,
+                 ec.message());
+    return;
+  }
+  spdlog::info("pipeline cache saved to {}, {} KB", pipeline_cache_file_,
+               size >> 10);
+}
+
 VkCommandBuffer Device::BeginSingleTimeCommands() {
   VkCommandBufferAllocateInfo alloc_info{};
   alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -161,12 +305,11 @@ VkFormat Device::FindSupportFormat(const std::vector<VkFormat>& candidates,
 }
 
 uint32_t Device::GetAlignedUniformByteOffset(const uint32_t offset) {
-  VkPhysicalDeviceProperties props;
-  vkGetPhysicalDeviceProperties(physical_device_, &props);
-  static const uint32_t min_alignment = props.limits.minUniformBufferOffsetAlignment;
-  uint32_t aligned_offset = offset + min_alignment - 1;
-  aligned_offset = aligned_offset - (aligned_offset % min_alignment);
-  return aligned_offset;
+  return AlignUp(offset, uniform_alignment_);
+}
+
+uint32_t Device::GetAlignedStorageByteOffset(const uint32_t offset) {
+  return AlignUp(offset, storage_alignment_);
 }
 
 void Device::Destroy() {
@@ -175,6 +318,15 @@ void Device::Destroy() {
     spdlog::debug("command pool destroyed");
   }
   if (device_) {
+    MemoryAllocator::Stats stats = allocator_.GetStats();
+    spdlog::debug("memory: {} blocks {} MB, {} allocations {} MB, {} dedicated",
+                  stats.n_block_, stats.block_bytes_ >> 20, stats.n_alloc_,
+                  stats.alloc_bytes_ >> 20, stats.n_dedicated_);
+    uploader_.Destroy();
+    allocator_.Destroy();
+    if (pipeline_cache_ != VK_NULL_HANDLE) {
+      vkDestroyPipelineCache(device_, pipeline_cache_, nullptr);
+    }
     vkDestroyDevice(device_, nullptr);
     spdlog::debug("logical device destroyed");
   }
@@ -2,8 +2,11 @@
 
 #include <vulkan/vulkan.h>
 
+#include <string>
 #include <vector>
 
+#include "memory/allocator.h"
+#include "memory/uploader.h"
 #include "surface/swapchain.h"
 
 namespace Rain {
@@ -12,18 +15,41 @@ class Device {
   VkDevice device_ = VK_NULL_HANDLE;
   VkPhysicalDevice physical_device_ = VK_NULL_HANDLE;
   VkPhysicalDeviceMemoryProperties physicalmem_properties_;
+  // minUniformBufferOffsetAlignment and minStorageBufferOffsetAlignment
+  uint32_t uniform_alignment_ = 1;
+  uint32_t storage_alignment_ = 1;
   VkQueue graphics_queue_ = VK_NULL_HANDLE;
   VkQueue present_queue_ = VK_NULL_HANDLE;
+  // the graphics queue when there is no dedicated transfer queue family
+  VkQueue transfer_queue_ = VK_NULL_HANDLE;
+  uint32_t graphics_queue_family_ = 0;
+  uint32_t transfer_queue_family_ = 0;
+  // enabled at creation, the optional ones only when supported
+  VkPhysicalDeviceFeatures features_{};
+  // VK_KHR_draw_indirect_count, null when the extension is not enabled
+  PFN_vkCmdDrawIndexedIndirectCountKHR draw_indexed_indirect_count_ = nullptr;
   VkCommandPool command_pool_ = VK_NULL_HANDLE;
   std::vector<VkCommandBuffer> command_buffers_;
+  // every pipeline is created through it, starting from the one saved in
+  // pipeline_cache_file_ by the same driver on the same device
+  VkPipelineCache pipeline_cache_ = VK_NULL_HANDLE;
+  std::string pipeline_cache_file_ = "pipeline_cache.bin";
   SwapChain* swap_chain_ = nullptr;
+  // every buffer and image memory comes from here
+  MemoryAllocator allocator_;
+  // batches the copies into device local buffers
+  Uploader uploader_;
 
   VkResult Init(VkPhysicalDevice physical_device,
                 uint32_t graphics_queue_family_index,
                 uint32_t present_queue_family_index,
+                uint32_t transfer_queue_family_index,
                 const std::vector<const char*>* layers,
                 const std::vector<const char*>* extensions);
   VkResult AllocateCommandBuffers(SwapChain* swap_chain);
+  VkResult InitPipelineCache();
+  // the data of pipeline_cache_ back into pipeline_cache_file_
+  void SavePipelineCache();
   VkCommandBuffer BeginSingleTimeCommands();
   void EndSingleTimeCommands(VkCommandBuffer command_buffer);
   uint32_t FindMemoryTypeIndex(uint32_t type_filter,
@@ -33,6 +59,7 @@ class Device {
                              VkImageTiling tiling,
                              VkFormatFeatureFlags features);
   uint32_t GetAlignedUniformByteOffset(const uint32_t offset);
+  uint32_t GetAlignedStorageByteOffset(const uint32_t offset);
   void Destroy();
 };
 };  // namespace Rain
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <string>
 #include <vector>
 
@@ -52,6 +53,7 @@ VkBool32 PhysicalDevice::Init(VkInstance instance, VkSurfaceKHR surface) {
   device_ = physical_devices[idx_device];
   queue_family_indices_ = FindQueueFamilies(device_, surface, false);
   swap_chain_support_details_ = QuerySwapChainSupport(device_, surface, false);
+  GetEnabledExtensions(device_);
   spdlog::info("GPU{} picked", idx_device);
   return VK_SUCCESS;
 }
@@ -73,6 +75,15 @@ void PhysicalDevice::GetGraphicsPresentQueueFamily(
   }
 }
 
+uint32_t PhysicalDevice::GetTransferQueueFamily(
+    uint32_t graphics_queue_family) {
+  if (!queue_family_indices_.transfer_only_family_.empty())
+    return *queue_family_indices_.transfer_only_family_.begin();
+  if (!queue_family_indices_.transfer_family_.empty())
+    return *queue_family_indices_.transfer_family_.begin();
+  return graphics_queue_family;
+}
+
 PhysicalDevice::QueueFamilyIndices PhysicalDevice::FindQueueFamilies(
     VkPhysicalDevice device, VkSurfaceKHR surface, bool verbose) {
   QueueFamilyIndices indices;
@@ -95,6 +106,11 @@ PhysicalDevice::QueueFamilyIndices PhysicalDevice::FindQueueFamilies(
     }
     if (queue_family.queueFlags & VK_QUEUE_TRANSFER_BIT) {
       flags += " transfer";
+      if (!(queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+        indices.transfer_family_.insert(i);
+        if (!(queue_family.queueFlags & VK_QUEUE_COMPUTE_BIT))
+          indices.transfer_only_family_.insert(i);
+      }
     }
     VkBool32 present_support = false;
     vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &present_support);
@@ -125,6 +141,25 @@ bool PhysicalDevice::CheckDeviceExtensionSupport(VkPhysicalDevice device,
   return required_extensions.empty();
 }
 
+void PhysicalDevice::GetEnabledExtensions(VkPhysicalDevice device) {
+  uint32_t extension_count = 0;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count,
+                                       nullptr);
+  std::vector<VkExtensionProperties> available_extensions(extension_count);
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count,
+                                       available_extensions.data());
+  enabled_extensions_ = device_extensions_;
+  for (const char* name : optional_extensions_) {
+    for (const auto& extension : available_extensions) {
+      if (strcmp(name, extension.extensionName) == 0) {
+        enabled_extensions_.push_back(name);
+        spdlog::debug("{} enabled", name);
+        break;
+      }
+    }
+  }
+}
+
 PhysicalDevice::SwapChainSupportDetails PhysicalDevice::QuerySwapChainSupport(
     VkPhysicalDevice device, VkSurfaceKHR surface, bool verbose) {
   SwapChainSupportDetails details;
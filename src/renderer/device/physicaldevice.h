@@ -14,6 +14,10 @@ class PhysicalDevice {
     std::set<uint32_t> graphics_family_;
     std::set<uint32_t> compute_family_;
     std::set<uint32_t> present_family_;
+    // transfer capable families without graphics
+    std::set<uint32_t> transfer_family_;
+    // of these, the ones without compute either, usually DMA engines
+    std::set<uint32_t> transfer_only_family_;
     bool IsComplete() {  // the queue family needed
       return (!graphics_family_.empty()) && (!present_family_.empty());
     }
@@ -30,14 +34,23 @@ class PhysicalDevice {
   VkPhysicalDevice device_ = VK_NULL_HANDLE;
   const std::vector<const char*> device_extensions_ = {
       VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+  // enabled when the picked device has them
+  const std::vector<const char*> optional_extensions_ = {
+      VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME};
+  // device_extensions_ and the supported optional ones
+  std::vector<const char*> enabled_extensions_;
 
   VkBool32 Init(VkInstance instance, VkSurfaceKHR surface);
   void GetGraphicsPresentQueueFamily(uint32_t& graphics_queue_family,
                                      uint32_t& present_queue_family);
+  // a transfer-only family when there is one, graphics_queue_family when
+  // there is no family without graphics
+  uint32_t GetTransferQueueFamily(uint32_t graphics_queue_family);
 
   QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device,
                                        VkSurfaceKHR surface, bool verbose);
   bool CheckDeviceExtensionSupport(VkPhysicalDevice device, bool verbose);
+  void GetEnabledExtensions(VkPhysicalDevice device);
   SwapChainSupportDetails QuerySwapChainSupport(VkPhysicalDevice device,
                                                 VkSurfaceKHR surface,
                                                 bool verbose);
@@ -5,9 +5,15 @@ VkResult Image::InitDepthImage(Device* device, uint32_t width,
                                uint32_t height) {
   VkResult result;
   format_ = device->FindDepthFormat();
+  VkImageUsageFlags usages = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+  // read by the depth pyramid of the GPU culling when the format allows it
+  if (device->FindSupportFormat({format_}, VK_IMAGE_TILING_OPTIMAL,
+                                VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) ==
+      format_) {
+    usages |= VK_IMAGE_USAGE_SAMPLED_BIT;
+  }
   result = CreateImage(device, width, height, format_, VK_IMAGE_TILING_OPTIMAL,
-                       VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                       usages, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
   if (result != VK_SUCCESS) {
     return result;
   }
@@ -59,13 +65,45 @@ VkResult Image::InitColorImage(Device* device, VkFormat format, uint32_t width,
   return VK_SUCCESS;
 }
 
+VkResult Image::InitStorageImage(Device* device, VkFormat format,
+                                 uint32_t width, uint32_t height,
+                                 uint32_t mip_levels) {
+  VkResult result;
+  result = CreateImage(
+      device, width, height, format, VK_IMAGE_TILING_OPTIMAL,
+      VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mip_levels);
+  if (result != VK_SUCCESS) {
+    return result;
+  }
+  VkImageViewCreateInfo view_info{};
+  view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  view_info.image = image_;
+  view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  view_info.format = format_;
+  view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  view_info.subresourceRange.baseMipLevel = 0;
+  view_info.subresourceRange.levelCount = mip_levels_;
+  view_info.subresourceRange.baseArrayLayer = 0;
+  view_info.subresourceRange.layerCount = 1;
+  result = vkCreateImageView(device->device_, &view_info, nullptr, &view_);
+  if (result != VK_SUCCESS) {
+    spdlog::error("image view creation failed");
+    return result;
+  }
+
+  return VK_SUCCESS;
+}
+
 VkResult Image::CreateImage(Device* device, uint32_t width, uint32_t height,
                             VkFormat format, VkImageTiling tiling,
                             VkImageUsageFlags usages,
-                            VkMemoryPropertyFlags properties) {
+                            VkMemoryPropertyFlags properties,
+                            uint32_t mip_levels) {
   VkResult result;
   width_ = width;
   height_ = height;
+  mip_levels_ = mip_levels;
   format_ = format;
   usages_ = usages;
   layout_ = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -76,7 +114,7 @@ VkResult Image::CreateImage(Device* device, uint32_t width, uint32_t height,
   image_info.extent.width = width_;
   image_info.extent.height = height_;
   image_info.extent.depth = 1;
-  image_info.mipLevels = 1;
+  image_info.mipLevels = mip_levels_;
   image_info.arrayLayers = 1;
   image_info.samples = VK_SAMPLE_COUNT_1_BIT;
   image_info.tiling = tiling;
@@ -91,22 +129,26 @@ VkResult Image::CreateImage(Device* device, uint32_t width, uint32_t height,
     return result;
   }
 
-  VkMemoryAllocateInfo alloc_info{};
-  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
   VkMemoryRequirements mem_reqs;
   vkGetImageMemoryRequirements(device->device_, image_, &mem_reqs);
-  alloc_info.allocationSize = mem_reqs.size;
-  alloc_info.memoryTypeIndex =
+  uint32_t memory_type =
       device->FindMemoryTypeIndex(mem_reqs.memoryTypeBits, properties);
-  result = vkAllocateMemory(device->device_, &alloc_info, nullptr, &memory_);
+  allocator_ = &device->allocator_;
+  result = allocator_->Allocate(mem_reqs, memory_type,
+                                tiling == VK_IMAGE_TILING_OPTIMAL, allocation_);
   if (result != VK_SUCCESS) {
-    spdlog::error("memory allocation failed");
+    vkDestroyImage(device->device_, image_, nullptr);
+    image_ = VK_NULL_HANDLE;
     return result;
   }
 
-  result = vkBindImageMemory(device->device_, image_, memory_, 0);
+  result = vkBindImageMemory(device->device_, image_, allocation_.memory_,
+                             allocation_.offset_);
   if (result != VK_SUCCESS) {
     spdlog::error("image memory binding failed");
+    vkDestroyImage(device->device_, image_, nullptr);
+    image_ = VK_NULL_HANDLE;
+    allocator_->Free(allocation_);
     return result;
   }
 
@@ -167,6 +209,8 @@ void Image::TransitionLayout(Device* device, VkImageLayout new_layout) {
 void Image::Destroy(VkDevice device) {
   if (view_ != VK_NULL_HANDLE) vkDestroyImageView(device, view_, nullptr);
   if (image_ != VK_NULL_HANDLE) vkDestroyImage(device, image_, nullptr);
-  if (memory_ != VK_NULL_HANDLE) vkFreeMemory(device, memory_, nullptr);
+  if (allocator_) allocator_->Free(allocation_);
+  view_ = VK_NULL_HANDLE;
+  image_ = VK_NULL_HANDLE;
 }
 };  // namespace Rain
\ No newline at end of file
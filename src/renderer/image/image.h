@@ -10,19 +10,25 @@ class Image {
  public:
   VkImage image_ = VK_NULL_HANDLE;
   VkImageView view_ = VK_NULL_HANDLE;
-  VkDeviceMemory memory_ = VK_NULL_HANDLE;
+  Allocation allocation_;
+  MemoryAllocator* allocator_ = nullptr;
   VkImageUsageFlags usages_;
   VkFormat format_;
   uint32_t width_;
   uint32_t height_;
+  uint32_t mip_levels_ = 1;
   VkImageLayout layout_;
 
   VkResult InitDepthImage(Device* device, uint32_t width, uint32_t height);
   VkResult InitColorImage(Device* device, VkFormat format, uint32_t width, uint32_t height);
+  // written by compute shaders and sampled, view_ covers every level
+  VkResult InitStorageImage(Device* device, VkFormat format, uint32_t width,
+                            uint32_t height, uint32_t mip_levels);
   VkResult CreateImage(Device* device, uint32_t width, uint32_t height,
                        VkFormat format, VkImageTiling tiling,
                        VkImageUsageFlags usages,
-                       VkMemoryPropertyFlags properties);
+                       VkMemoryPropertyFlags properties,
+                       uint32_t mip_levels = 1);
   void TransitionLayout(Device* device, VkImageLayout new_layout);
   void Destroy(VkDevice device);
   bool HasStencilComponent(VkFormat format) {
@@ -0,0 +1,176 @@
+#include "allocator.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+
+namespace Rain {
+void MemoryAllocator::Init(
+    VkDevice device,
+    const VkPhysicalDeviceMemoryProperties& memory_properties) {
+  device_ = device;
+  memory_properties_ = memory_properties;
+  pools_.resize(memory_properties_.memoryTypeCount * 2);
+  for (uint32_t i = 0; i < memory_properties_.memoryTypeCount; ++i) {
+    // small heaps, like the 256MB host visible window of device local
+    // memory, must not be taken by a few blocks
+    VkDeviceSize heap_size =
+        memory_properties_.memoryHeaps[memory_properties_.memoryTypes[i]
+                                           .heapIndex]
+            .size;
+    VkDeviceSize block_size =
+        std::min(VkDeviceSize(BLOCK_SIZE), heap_size / 8);
+    for (uint32_t j = 0; j < 2; ++j) {
+      pools_[i * 2 + j].memory_type_ = i;
+      pools_[i * 2 + j].block_size_ = block_size;
+    }
+  }
+  stats_ = Stats();
+}
+
+VkResult MemoryAllocator::Allocate(const VkMemoryRequirements& requirements,
+                                   uint32_t memory_type, bool optimal,
+                                   Allocation& allocation) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint32_t pool_index = memory_type * 2 + (optimal ? 1 : 0);
+  Pool& pool = pools_[pool_index];
+  allocation.pool_ = pool_index;
+  allocation.size_ = requirements.size;
+
+  // big resources get their own memory instead of fragmenting the blocks
+  if (requirements.size > pool.block_size_ / 2) {
+    VkResult result = AllocateMemory(memory_type, requirements.size,
+                                     allocation.memory_, allocation.mapped_);
+    if (result != VK_SUCCESS) return result;
+    allocation.offset_ = 0;
+    allocation.node_ = RangeAllocator::NULL_NODE;
+    ++stats_.n_dedicated_;
+    stats_.dedicated_bytes_ += requirements.size;
+    return VK_SUCCESS;
+  }
+
+  uint32_t free_slot = uint32_t(pool.blocks_.size());
+  for (uint32_t i = 0; i < pool.blocks_.size(); ++i) {
+    Block& block = pool.blocks_[i];
+    if (block.memory_ == VK_NULL_HANDLE) {
+      free_slot = std::min(free_slot, i);
+      continue;
+    }
+    uint64_t offset;
+    uint32_t node = block.ranges_.Allocate(requirements.size,
+                                           requirements.alignment, offset);
+    if (node == RangeAllocator::NULL_NODE) continue;
+    allocation.memory_ = block.memory_;
+    allocation.offset_ = offset;
+    allocation.mapped_ =
+        block.mapped_ ? static_cast<char*>(block.mapped_) + offset : nullptr;
+    allocation.block_ = i;
+    allocation.node_ = node;
+    ++stats_.n_alloc_;
+    stats_.alloc_bytes_ += requirements.size;
+    return VK_SUCCESS;
+  }
+
+  if (free_slot == pool.blocks_.size()) pool.blocks_.emplace_back();
+  Block& block = pool.blocks_[free_slot];
+  VkResult result =
+      AllocateMemory(memory_type, pool.block_size_, block.memory_,
+                     block.mapped_);
+  if (result != VK_SUCCESS) return result;
+  block.ranges_.Init(pool.block_size_);
+  ++stats_.n_block_;
+  stats_.block_bytes_ += pool.block_size_;
+  spdlog::debug("memory block {} of type {} created: {} MB", free_slot,
+                memory_type, pool.block_size_ >> 20);
+
+  uint64_t offset;
+  allocation.node_ = block.ranges_.Allocate(requirements.size,
+                                            requirements.alignment, offset);
+  allocation.memory_ = block.memory_;
+  allocation.offset_ = offset;
+  allocation.mapped_ =
+      block.mapped_ ? static_cast<char*>(block.mapped_) + offset : nullptr;
+  allocation.block_ = free_slot;
+  ++stats_.n_alloc_;
+  stats_.alloc_bytes_ += requirements.size;
+  return VK_SUCCESS;
+}
+
+void MemoryAllocator::Free(Allocation& allocation) {
+  if (allocation.memory_ == VK_NULL_HANDLE) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (allocation.node_ == RangeAllocator::NULL_NODE) {
+    FreeMemory(allocation.memory_, allocation.mapped_);
+    --stats_.n_dedicated_;
+    stats_.dedicated_bytes_ -= allocation.size_;
+  } else {
+    Pool& pool = pools_[allocation.pool_];
+    Block& block = pool.blocks_[allocation.block_];
+    block.ranges_.Free(allocation.node_);
+    --stats_.n_alloc_;
+    stats_.alloc_bytes_ -= allocation.size_;
+    // keep the first block of a pool around, models come and go
+    if (block.ranges_.Empty() && allocation.block_ != 0) {
+      FreeMemory(block.memory_, block.mapped_);
+      block.memory_ = VK_NULL_HANDLE;
+      block.mapped_ = nullptr;
+      --stats_.n_block_;
+      stats_.block_bytes_ -= pool.block_size_;
+    }
+  }
+  allocation = Allocation();
+}
+
+MemoryAllocator::Stats MemoryAllocator::GetStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void MemoryAllocator::Destroy() {
+  if (stats_.n_alloc_ || stats_.n_dedicated_) {
+    spdlog::warn("{} memory allocations still alive",
+                 stats_.n_alloc_ + stats_.n_dedicated_);
+  }
+  for (auto& pool : pools_) {
+    for (auto& block : pool.blocks_) {
+      if (block.memory_ != VK_NULL_HANDLE) {
+        FreeMemory(block.memory_, block.mapped_);
+      }
+    }
+  }
+  pools_.clear();
+  stats_ = Stats();
+}
+
+VkResult MemoryAllocator::AllocateMemory(uint32_t memory_type,
+                                         VkDeviceSize size,
+                                         VkDeviceMemory& memory,
+                                         void*& mapped) {
+  VkMemoryAllocateInfo alloc_info{};
+  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  alloc_info.allocationSize = size;
+  alloc_info.memoryTypeIndex = memory_type;
+  VkResult result = vkAllocateMemory(device_, &alloc_info, nullptr, &memory);
+  if (result != VK_SUCCESS) {
+    spdlog::error("memory allocation failed: size={} code={}", size, result);
+    return result;
+  }
+  mapped = nullptr;
+  if (memory_properties_.memoryTypes[memory_type].propertyFlags &
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    result = vkMapMemory(device_, memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+    if (result != VK_SUCCESS) {
+      spdlog::error("memory mapping failed");
+      vkFreeMemory(device_, memory, nullptr);
+      memory = VK_NULL_HANDLE;
+      return result;
+    }
+  }
+  return VK_SUCCESS;
+}
+
+void MemoryAllocator::FreeMemory(VkDeviceMemory memory, void* mapped) {
+  if (mapped) vkUnmapMemory(device_, memory);
+  vkFreeMemory(device_, memory, nullptr);
+}
+};  // namespace Rain
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <mutex>
+#include <vector>
+
+#include "memory/rangeallocator.h"
+
+namespace Rain {
+// a range of device memory handed out by MemoryAllocator
+struct Allocation {
+  VkDeviceMemory memory_ = VK_NULL_HANDLE;
+  VkDeviceSize offset_ = 0;
+  VkDeviceSize size_ = 0;
+  // host visible memory stays mapped for its lifetime, null otherwise
+  void* mapped_ = nullptr;
+  uint32_t pool_ = 0;
+  uint32_t block_ = 0;
+  // RangeAllocator::NULL_NODE for a dedicated allocation
+  uint32_t node_ = RangeAllocator::NULL_NODE;
+};
+
+// Reserves large blocks of device memory per memory type and sub-allocates
+// them, so the number of vkAllocateMemory calls stays far below
+// maxMemoryAllocationCount. Linear (buffer) and optimal (image) resources
+// use separate blocks, which keeps them bufferImageGranularity apart.
+class MemoryAllocator {
+ public:
+  static const VkDeviceSize BLOCK_SIZE = 64ull << 20;
+
+  struct Block {
+    VkDeviceMemory memory_ = VK_NULL_HANDLE;
+    void* mapped_ = nullptr;
+    RangeAllocator ranges_;
+  };
+  struct Pool {
+    uint32_t memory_type_;
+    VkDeviceSize block_size_;
+    // slots of released blocks are reused, so block indices stay valid
+    std::vector<Block> blocks_;
+  };
+  struct Stats {
+    uint32_t n_block_ = 0;
+    uint64_t block_bytes_ = 0;
+    uint32_t n_alloc_ = 0;
+    uint64_t alloc_bytes_ = 0;
+    uint32_t n_dedicated_ = 0;
+    uint64_t dedicated_bytes_ = 0;
+  };
+
+  VkDevice device_ = VK_NULL_HANDLE;
+  VkPhysicalDeviceMemoryProperties memory_properties_;
+  // 2 per memory type: linear then optimal
+  std::vector<Pool> pools_;
+  Stats stats_;
+  std::mutex mutex_;
+
+  void Init(VkDevice device,
+            const VkPhysicalDeviceMemoryProperties& memory_properties);
+  VkResult Allocate(const VkMemoryRequirements& requirements,
+                    uint32_t memory_type, bool optimal,
+                    Allocation& allocation);
+  void Free(Allocation& allocation);
+  Stats GetStats();
+  void Destroy();
+
+  VkResult AllocateMemory(uint32_t memory_type, VkDeviceSize size,
+                          VkDeviceMemory& memory, void*& mapped);
+  void FreeMemory(VkDeviceMemory memory, void* mapped);
+};
+};  // namespace Rain
\ No newline at end of file
@@ -0,0 +1,205 @@
+#include "rangeallocator.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace Rain {
+namespace {
+inline uint32_t Msb(uint64_t x) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanReverse64(&index, x);
+  return uint32_t(index);
+#else
+  return 63 - uint32_t(__builtin_clzll(x));
+#endif
+}
+
+inline uint32_t Lsb(uint64_t x) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, x);
+  return uint32_t(index);
+#else
+  return uint32_t(__builtin_ctzll(x));
+#endif
+}
+}  // namespace
+
+void RangeAllocator::Init(uint64_t size) {
+  nodes_.clear();
+  unused_nodes_.clear();
+  fl_bitmap_ = 0;
+  for (uint32_t fl = 0; fl < FL_COUNT; ++fl) {
+    sl_bitmap_[fl] = 0;
+    for (uint32_t sl = 0; sl < SL_COUNT; ++sl) heads_[fl][sl] = NULL_NODE;
+  }
+  size_ = size;
+  used_ = 0;
+  n_alloc_ = 0;
+  uint32_t node = NewNode();
+  nodes_[node] = {0, size, NULL_NODE, NULL_NODE, NULL_NODE, NULL_NODE, false};
+  last_ = node;
+  InsertFree(node);
+}
+
+uint32_t RangeAllocator::Allocate(uint64_t size, uint64_t alignment,
+                                  uint64_t& offset) {
+  if (size == 0) size = 1;
+  if (alignment == 0) alignment = 1;
+  // round up to the next size class, then every range found there fits
+  // even after the worst alignment padding
+  uint64_t search = size + alignment - 1;
+  if (search >= SL_COUNT) search += (1ull << (Msb(search) - SL_LOG2)) - 1;
+  uint32_t fl, sl;
+  Mapping(search, fl, sl);
+  if (fl >= FL_COUNT) return NULL_NODE;
+  uint32_t sl_map = sl_bitmap_[fl] & (~0u << sl);
+  if (!sl_map) {
+    uint64_t fl_map = fl + 1 < 64 ? fl_bitmap_ & (~0ull << (fl + 1)) : 0;
+    if (!fl_map) return NULL_NODE;
+    fl = Lsb(fl_map);
+    sl_map = sl_bitmap_[fl];
+  }
+  sl = Lsb(sl_map);
+  uint32_t node = heads_[fl][sl];
+  RemoveFree(node);
+
+  uint64_t begin = nodes_[node].offset_;
+  uint64_t aligned = (begin + alignment - 1) / alignment * alignment;
+  if (aligned != begin) {
+    // the padding stays free in front of the allocation
+    uint32_t tail = Split(node, aligned - begin);
+    InsertFree(node);
+    node = tail;
+  }
+  if (nodes_[node].size_ > size) {
+    InsertFree(Split(node, size));
+  }
+  offset = aligned;
+  used_ += size;
+  ++n_alloc_;
+  return node;
+}
+
+void RangeAllocator::Free(uint32_t node) {
+  used_ -= nodes_[node].size_;
+  --n_alloc_;
+  uint32_t prev = nodes_[node].prev_phys_;
+  if (prev != NULL_NODE && nodes_[prev].free_) {
+    RemoveFree(prev);
+    Merge(prev, node);
+    node = prev;
+  }
+  uint32_t next = nodes_[node].next_phys_;
+  if (next != NULL_NODE && nodes_[next].free_) {
+    RemoveFree(next);
+    Merge(node, next);
+  }
+  InsertFree(node);
+}
+
+void RangeAllocator::Grow(uint64_t size) {
+  if (size <= size_) return;
+  uint64_t extra = size - size_;
+  size_ = size;
+  if (nodes_[last_].free_) {
+    RemoveFree(last_);
+    nodes_[last_].size_ += extra;
+    InsertFree(last_);
+    return;
+  }
+  uint32_t node = NewNode();
+  uint64_t end = nodes_[last_].offset_ + nodes_[last_].size_;
+  nodes_[node] = {end, extra, last_, NULL_NODE, NULL_NODE, NULL_NODE, false};
+  nodes_[last_].next_phys_ = node;
+  last_ = node;
+  InsertFree(node);
+}
+
+uint64_t RangeAllocator::LargestFree() const {
+  if (!fl_bitmap_) return 0;
+  uint32_t fl = Msb(fl_bitmap_);
+  uint32_t sl = Msb(sl_bitmap_[fl]);
+  uint64_t largest = 0;
+  for (uint32_t node = heads_[fl][sl]; node != NULL_NODE;
+       node = nodes_[node].next_free_) {
+    if (nodes_[node].size_ > largest) largest = nodes_[node].size_;
+  }
+  return largest;
+}
+
+uint32_t RangeAllocator::NewNode() {
+  if (!unused_nodes_.empty()) {
+    uint32_t node = unused_nodes_.back();
+    unused_nodes_.pop_back();
+    return node;
+  }
+  nodes_.emplace_back();
+  return uint32_t(nodes_.size() - 1);
+}
+
+uint32_t RangeAllocator::Split(uint32_t node, uint64_t at) {
+  uint32_t tail = NewNode();
+  Node& front = nodes_[node];
+  nodes_[tail] = {front.offset_ + at, front.size_ - at, node,
+                  front.next_phys_,   NULL_NODE,        NULL_NODE,
+                  false};
+  if (front.next_phys_ != NULL_NODE) nodes_[front.next_phys_].prev_phys_ = tail;
+  front.next_phys_ = tail;
+  front.size_ = at;
+  if (last_ == node) last_ = tail;
+  return tail;
+}
+
+void RangeAllocator::Merge(uint32_t front, uint32_t back) {
+  nodes_[front].size_ += nodes_[back].size_;
+  uint32_t next = nodes_[back].next_phys_;
+  nodes_[front].next_phys_ = next;
+  if (next != NULL_NODE) nodes_[next].prev_phys_ = front;
+  if (last_ == back) last_ = front;
+  unused_nodes_.push_back(back);
+}
+
+void RangeAllocator::InsertFree(uint32_t node) {
+  uint32_t fl, sl;
+  Mapping(nodes_[node].size_, fl, sl);
+  uint32_t head = heads_[fl][sl];
+  nodes_[node].free_ = true;
+  nodes_[node].prev_free_ = NULL_NODE;
+  nodes_[node].next_free_ = head;
+  if (head != NULL_NODE) nodes_[head].prev_free_ = node;
+  heads_[fl][sl] = node;
+  fl_bitmap_ |= 1ull << fl;
+  sl_bitmap_[fl] |= 1u << sl;
+}
+
+void RangeAllocator::RemoveFree(uint32_t node) {
+  Node& n = nodes_[node];
+  if (n.prev_free_ != NULL_NODE) {
+    nodes_[n.prev_free_].next_free_ = n.next_free_;
+  } else {
+    uint32_t fl, sl;
+    Mapping(n.size_, fl, sl);
+    heads_[fl][sl] = n.next_free_;
+    if (n.next_free_ == NULL_NODE) {
+      sl_bitmap_[fl] &= ~(1u << sl);
+      if (!sl_bitmap_[fl]) fl_bitmap_ &= ~(1ull << fl);
+    }
+  }
+  if (n.next_free_ != NULL_NODE) nodes_[n.next_free_].prev_free_ = n.prev_free_;
+  n.free_ = false;
+}
+
+void RangeAllocator::Mapping(uint64_t size, uint32_t& fl, uint32_t& sl) {
+  if (size < SL_COUNT) {
+    fl = 0;
+    sl = uint32_t(size);
+    return;
+  }
+  uint32_t msb = Msb(size);
+  fl = msb - SL_LOG2 + 1;
+  sl = uint32_t(size >> (msb - SL_LOG2)) - SL_COUNT;
+}
+};  // namespace Rain
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace Rain {
+// Two-level segregated fit (TLSF) over the offsets [0, size): allocate and
+// free are O(1), a freed range merges with free neighbours right away. Only
+// offsets are managed, the memory behind them belongs to the caller.
+class RangeAllocator {
+ public:
+  static const uint32_t NULL_NODE = UINT32_MAX;
+  // each power of two size class is split into SL_COUNT linear classes
+  static const uint32_t SL_LOG2 = 4;
+  static const uint32_t SL_COUNT = 1u << SL_LOG2;
+  static const uint32_t FL_COUNT = 64 - SL_LOG2 + 1;
+
+  // one range, in address order with its neighbours and, while free, in the
+  // list of its size class
+  struct Node {
+    uint64_t offset_;
+    uint64_t size_;
+    uint32_t prev_phys_;
+    uint32_t next_phys_;
+    uint32_t prev_free_;
+    uint32_t next_free_;
+    bool free_;
+  };
+
+  std::vector<Node> nodes_;
+  std::vector<uint32_t> unused_nodes_;
+  uint64_t fl_bitmap_ = 0;
+  uint32_t sl_bitmap_[FL_COUNT] = {};
+  uint32_t heads_[FL_COUNT][SL_COUNT];
+  uint32_t last_ = NULL_NODE;  // node at the end of the range
+  uint64_t size_ = 0;
+  uint64_t used_ = 0;
+  uint32_t n_alloc_ = 0;
+
+  void Init(uint64_t size);
+  // returns the node holding [offset, offset + size), or NULL_NODE when no
+  // free range fits
+  uint32_t Allocate(uint64_t size, uint64_t alignment, uint64_t& offset);
+  void Free(uint32_t node);
+  // extend the range to [0, size), live nodes keep their offsets
+  void Grow(uint64_t size);
+  bool Empty() const { return n_alloc_ == 0; }
+  uint64_t LargestFree() const;
+
+  uint32_t NewNode();
+  // cut node at the given distance, the tail becomes a new node
+  uint32_t Split(uint32_t node, uint64_t at);
+  void Merge(uint32_t front, uint32_t back);
+  void InsertFree(uint32_t node);
+  void RemoveFree(uint32_t node);
+  static void Mapping(uint64_t size, uint32_t& fl, uint32_t& sl);
+};
+};  // namespace Rain
\ No newline at end of file
@@ -0,0 +1,286 @@
+#include "uploader.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace Rain {
+namespace {
+VkResult CreateCommandBuffers(VkDevice device, uint32_t family,
+                              VkCommandPool& pool,
+                              std::vector<VkCommandBuffer>& command_buffers) {
+  VkCommandPoolCreateInfo pool_info{};
+  pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  pool_info.queueFamilyIndex = family;
+  pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                    VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  VkResult result = vkCreateCommandPool(device, &pool_info, nullptr, &pool);
+  if (result != VK_SUCCESS) {
+    spdlog::error("upload command pool creation failed");
+    return result;
+  }
+  VkCommandBufferAllocateInfo alloc_info{};
+  alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  alloc_info.commandPool = pool;
+  alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  alloc_info.commandBufferCount = uint32_t(command_buffers.size());
+  result = vkAllocateCommandBuffers(device, &alloc_info,
+                                    command_buffers.data());
+  if (result != VK_SUCCESS) {
+    spdlog::error("upload command buffer allocation failed");
+    return result;
+  }
+  return VK_SUCCESS;
+}
+}  // namespace
+
+VkResult Uploader::Init(VkDevice device, uint32_t transfer_family,
+                        VkQueue transfer_queue, uint32_t graphics_family,
+                        VkQueue graphics_queue, MemoryAllocator* allocator) {
+  VkResult result;
+  device_ = device;
+  transfer_family_ = transfer_family;
+  transfer_queue_ = transfer_queue;
+  graphics_family_ = graphics_family;
+  graphics_queue_ = graphics_queue;
+  allocator_ = allocator;
+
+  std::vector<VkCommandBuffer> command_buffers(N_SEGMENT);
+  result = CreateCommandBuffers(device_, transfer_family_, command_pool_,
+                                command_buffers);
+  if (result != VK_SUCCESS) return result;
+  for (uint32_t i = 0; i < N_SEGMENT; ++i) {
+    segments_[i].command_buffer_ = command_buffers[i];
+  }
+  for (auto& segment : segments_) {
+    VkFenceCreateInfo fence_info{};
+    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    result = vkCreateFence(device_, &fence_info, nullptr, &segment.fence_);
+    if (result != VK_SUCCESS) {
+      spdlog::error("upload fence creation failed");
+      return result;
+    }
+    if (!HasTransferQueue()) continue;
+    VkSemaphoreCreateInfo semaphore_info{};
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    result = vkCreateSemaphore(device_, &semaphore_info, nullptr,
+                               &segment.semaphore_);
+    if (result != VK_SUCCESS) {
+      spdlog::error("upload semaphore creation failed");
+      return result;
+    }
+  }
+
+  VkBufferCreateInfo buffer_info{};
+  buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_info.size = SEGMENT_SIZE * N_SEGMENT;
+  buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  result = vkCreateBuffer(device_, &buffer_info, nullptr, &staging_buffer_);
+  if (result != VK_SUCCESS) {
+    spdlog::error("staging buffer creation failed");
+    return result;
+  }
+  VkMemoryRequirements mem_req;
+  vkGetBufferMemoryRequirements(device_, staging_buffer_, &mem_req);
+  uint32_t memory_type = UINT32_MAX;
+  const VkMemoryPropertyFlags properties =
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  for (uint32_t i = 0; i < allocator_->memory_properties_.memoryTypeCount;
+       ++i) {
+    if ((mem_req.memoryTypeBits & (1 << i)) &&
+        (allocator_->memory_properties_.memoryTypes[i].propertyFlags &
+         properties) == properties) {
+      memory_type = i;
+      break;
+    }
+  }
+  if (memory_type == UINT32_MAX) {
+    spdlog::error("no host visible memory for staging");
+    return VK_ERROR_FEATURE_NOT_PRESENT;
+  }
+  result = allocator_->Allocate(mem_req, memory_type, false,
+                                staging_allocation_);
+  if (result != VK_SUCCESS) return result;
+  return vkBindBufferMemory(device_, staging_buffer_,
+                            staging_allocation_.memory_,
+                            staging_allocation_.offset_);
+}
+
+VkResult Uploader::Upload(VkBuffer dst, VkDeviceSize offset, const void* data,
+                          VkDeviceSize size) {
+  VkResult result;
+  const char* src = static_cast<const char*>(data);
+  while (size > 0) {
+    if (!segments_[current_].recording_) {
+      result = Begin(segments_[current_]);
+      if (result != VK_SUCCESS) return result;
+    }
+    // keep the copies 16-byte aligned in the staging buffer
+    VkDeviceSize begin =
+        (segments_[current_].used_ + 15) & ~VkDeviceSize(15);
+    if (begin >= SEGMENT_SIZE) {
+      result = Advance();
+      if (result != VK_SUCCESS) return result;
+      result = Begin(segments_[current_]);
+      if (result != VK_SUCCESS) return result;
+      begin = 0;
+    }
+    Segment& segment = segments_[current_];
+    VkDeviceSize n = std::min(size, SEGMENT_SIZE - begin);
+    VkDeviceSize staging_offset = current_ * SEGMENT_SIZE + begin;
+    memcpy(static_cast<char*>(staging_allocation_.mapped_) + staging_offset,
+           src, size_t(n));
+    VkBufferCopy region{};
+    region.srcOffset = staging_offset;
+    region.dstOffset = offset;
+    region.size = n;
+    vkCmdCopyBuffer(segment.command_buffer_, staging_buffer_, dst, 1,
+                    &region);
+    segment.used_ = begin + n;
+    ++stats_.n_copy_;
+    stats_.bytes_ += n;
+    src += n;
+    offset += n;
+    size -= n;
+  }
+  return VK_SUCCESS;
+}
+
+VkResult Uploader::Submit() {
+  if (!segments_[current_].recording_) return VK_SUCCESS;
+  return Advance();
+}
+
+VkResult Uploader::Flush() {
+  VkResult result = Submit(segments_[current_]);
+  if (result != VK_SUCCESS) return result;
+  for (auto& segment : segments_) {
+    result = Wait(segment);
+    if (result != VK_SUCCESS) return result;
+  }
+  return VK_SUCCESS;
+}
+
+void Uploader::Destroy() {
+  if (device_ == VK_NULL_HANDLE) return;
+  for (auto& segment : segments_) {
+    Wait(segment);
+    if (segment.fence_ != VK_NULL_HANDLE) {
+      vkDestroyFence(device_, segment.fence_, nullptr);
+    }
+    if (segment.semaphore_ != VK_NULL_HANDLE) {
+      vkDestroySemaphore(device_, segment.semaphore_, nullptr);
+    }
+    segment = Segment();
+  }
+  if (command_pool_ != VK_NULL_HANDLE) {
+    vkDestroyCommandPool(device_, command_pool_, nullptr);
+    command_pool_ = VK_NULL_HANDLE;
+  }
+  if (staging_buffer_ != VK_NULL_HANDLE) {
+    vkDestroyBuffer(device_, staging_buffer_, nullptr);
+    staging_buffer_ = VK_NULL_HANDLE;
+  }
+  allocator_->Free(staging_allocation_);
+  spdlog::debug("uploader: {} copies {} MB in {} submits", stats_.n_copy_,
+                stats_.bytes_ >> 20, stats_.n_submit_);
+}
+
+VkResult Uploader::Begin(Segment& segment) {
+  VkCommandBufferBeginInfo begin_info{};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  VkResult result = vkBeginCommandBuffer(segment.command_buffer_, &begin_info);
+  if (result != VK_SUCCESS) {
+    spdlog::error("upload command buffer recording start failed");
+    return result;
+  }
+  segment.recording_ = true;
+  segment.used_ = 0;
+  return VK_SUCCESS;
+}
+
+VkResult Uploader::Submit(Segment& segment) {
+  if (!segment.recording_) return VK_SUCCESS;
+  VkResult result;
+  segment.recording_ = false;
+  VkSubmitInfo submit_info{};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &segment.command_buffer_;
+
+  if (!HasTransferQueue()) {
+    // later submissions to the same queue read the uploaded data
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    vkCmdPipelineBarrier(segment.command_buffer_,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0,
+                         nullptr, 0, nullptr);
+  }
+  result = vkEndCommandBuffer(segment.command_buffer_);
+  if (result != VK_SUCCESS) {
+    spdlog::error("upload command buffer recording failed");
+    return result;
+  }
+  if (!HasTransferQueue()) {
+    result = vkQueueSubmit(transfer_queue_, 1, &submit_info, segment.fence_);
+    if (result != VK_SUCCESS) {
+      spdlog::error("upload submission failed");
+      return result;
+    }
+    segment.pending_ = true;
+    ++stats_.n_submit_;
+    return VK_SUCCESS;
+  }
+
+  submit_info.signalSemaphoreCount = 1;
+  submit_info.pSignalSemaphores = &segment.semaphore_;
+  result = vkQueueSubmit(transfer_queue_, 1, &submit_info, VK_NULL_HANDLE);
+  if (result != VK_SUCCESS) {
+    spdlog::error("upload submission failed");
+    return result;
+  }
+  // the semaphore makes the copies visible to everything the graphics queue
+  // runs after this wait, the destinations are concurrent so nothing needs
+  // to be acquired
+  VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+  VkSubmitInfo wait_info{};
+  wait_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  wait_info.waitSemaphoreCount = 1;
+  wait_info.pWaitSemaphores = &segment.semaphore_;
+  wait_info.pWaitDstStageMask = &wait_stage;
+  result = vkQueueSubmit(graphics_queue_, 1, &wait_info, segment.fence_);
+  if (result != VK_SUCCESS) {
+    spdlog::error("upload wait submission failed");
+    return result;
+  }
+  segment.pending_ = true;
+  ++stats_.n_submit_;
+  return VK_SUCCESS;
+}
+
+VkResult Uploader::Wait(Segment& segment) {
+  if (!segment.pending_) return VK_SUCCESS;
+  VkResult result =
+      vkWaitForFences(device_, 1, &segment.fence_, VK_TRUE, UINT64_MAX);
+  if (result != VK_SUCCESS) {
+    spdlog::error("upload fence wait failed");
+    return result;
+  }
+  segment.pending_ = false;
+  return vkResetFences(device_, 1, &segment.fence_);
+}
+
+VkResult Uploader::Advance() {
+  VkResult result = Submit(segments_[current_]);
+  if (result != VK_SUCCESS) return result;
+  current_ = (current_ + 1) % N_SEGMENT;
+  return Wait(segments_[current_]);
+}
+};  // namespace Rain
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+#include "memory/allocator.h"
+
+namespace Rain {
+// Batches buffer uploads. Data is copied into a persistently mapped staging
+// ring and the copies are recorded into the command buffer of the current
+// ring segment, which runs on the transfer queue. With a dedicated transfer
+// queue family the segment signals a semaphore that an empty submit on the
+// graphics queue waits for, so frames submitted later are ordered after the
+// copies on the GPU without stalling the CPU. The destinations are shared
+// concurrently by both families (see Buffer::CreateBuffer), so no ownership
+// moves between them. Copies of one batch run unordered, so their
+// destinations must not overlap.
+class Uploader {
+ public:
+  static const uint32_t N_SEGMENT = 4;
+  static const VkDeviceSize SEGMENT_SIZE = 8ull << 20;
+
+  struct Segment {
+    VkCommandBuffer command_buffer_ = VK_NULL_HANDLE;  // transfer queue
+    VkSemaphore semaphore_ = VK_NULL_HANDLE;  // copies done
+    VkFence fence_ = VK_NULL_HANDLE;  // copies done and waited for
+    VkDeviceSize used_ = 0;
+    bool recording_ = false;
+    bool pending_ = false;  // submitted, fence not waited for yet
+  };
+  struct Stats {
+    uint64_t n_copy_ = 0;
+    uint64_t bytes_ = 0;
+    uint64_t n_submit_ = 0;
+  };
+
+  VkDevice device_ = VK_NULL_HANDLE;
+  VkQueue transfer_queue_ = VK_NULL_HANDLE;
+  VkQueue graphics_queue_ = VK_NULL_HANDLE;
+  uint32_t transfer_family_ = 0;
+  uint32_t graphics_family_ = 0;
+  VkCommandPool command_pool_ = VK_NULL_HANDLE;
+  MemoryAllocator* allocator_ = nullptr;
+  VkBuffer staging_buffer_ = VK_NULL_HANDLE;
+  Allocation staging_allocation_;
+  Segment segments_[N_SEGMENT];
+  uint32_t current_ = 0;
+  Stats stats_;
+
+  VkResult Init(VkDevice device, uint32_t transfer_family,
+                VkQueue transfer_queue, uint32_t graphics_family,
+                VkQueue graphics_queue, MemoryAllocator* allocator);
+  bool HasTransferQueue() const { return transfer_family_ != graphics_family_; }
+  // copy size bytes of data to dst at offset once the batch is submitted,
+  // data may be released right after the call
+  VkResult Upload(VkBuffer dst, VkDeviceSize offset, const void* data,
+                  VkDeviceSize size);
+  // hand the recorded copies to the queues without waiting, graphics work
+  // submitted afterwards sees them
+  VkResult Submit();
+  // submit and wait until every copy is done
+  VkResult Flush();
+  void Destroy();
+
+  VkResult Begin(Segment& segment);
+  VkResult Submit(Segment& segment);
+  VkResult Wait(Segment& segment);
+  // move on in the ring, the next segment may still be in flight
+  VkResult Advance();
+};
+};  // namespace Rain
\ No newline at end of file
@@ -1,8 +1,11 @@
 #include "pipeline.h"
 
+#include <chrono>
+
 namespace Rain {
-VkResult Pipeline::Init(VkDevice device, const VkExtent2D& extent,
-                        VkRenderPass render_pass, RenderScene* scene) {
+VkResult Pipeline::Init(VkDevice device, VkPipelineCache cache,
+                        const VkExtent2D& extent, VkRenderPass render_pass,
+                        RenderScene* scene) {
   shader_ = new Shader;
   VkResult result;
   result = shader_->Init(device, "basic");
@@ -23,6 +26,17 @@ VkResult Pipeline::Init(VkDevice device, const VkExtent2D& extent,
       VK_SHADER_STAGE_CALLABLE_BIT_NV,
       VK_SHADER_STAGE_TASK_BIT_NV,
       VK_SHADER_STAGE_MESH_BIT_NV};
+  // constant_id 0 of basic.vert selects the vertex format
+  VkSpecializationMapEntry compact_entry{};
+  compact_entry.constantID = 0;
+  compact_entry.offset = 0;
+  compact_entry.size = sizeof(VkBool32);
+  VkBool32 compact = VK_FALSE;
+  VkSpecializationInfo specialization_info{};
+  specialization_info.mapEntryCount = 1;
+  specialization_info.pMapEntries = &compact_entry;
+  specialization_info.dataSize = sizeof(VkBool32);
+  specialization_info.pData = &compact;
   std::vector<VkPipelineShaderStageCreateInfo> shader_stage_infos;
   for (size_t i = 0; i < Shader::SHADER_STAGE_NUM; ++i) {
     if (shader_->modules_[i] == VK_NULL_HANDLE) continue;
@@ -31,20 +45,14 @@ VkResult Pipeline::Init(VkDevice device, const VkExtent2D& extent,
     create_info.stage = stage_map[i];
     create_info.module = shader_->modules_[i];
     create_info.pName = "main";
+    if (i == Shader::SHADER_STAGE_VERTEX)
+      create_info.pSpecializationInfo = &specialization_info;
     shader_stage_infos.push_back(create_info);
   }
 
   VkPipelineVertexInputStateCreateInfo vertex_input_info{};
-  auto binding_descs = RenderModel::GetBindDescription();
-  auto attr_descs = RenderModel::GetAttributeDescriptions();
   vertex_input_info.sType =
       VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-  vertex_input_info.vertexBindingDescriptionCount =
-      static_cast<uint32_t>(binding_descs.size());
-  vertex_input_info.pVertexBindingDescriptions = binding_descs.data();
-  vertex_input_info.vertexAttributeDescriptionCount =
-      static_cast<uint32_t>(attr_descs.size());
-  vertex_input_info.pVertexAttributeDescriptions = attr_descs.data();
 
   VkPipelineInputAssemblyStateCreateInfo input_assembly_info{};
   input_assembly_info.sType =
@@ -141,12 +149,33 @@ VkResult Pipeline::Init(VkDevice device, const VkExtent2D& extent,
   pipeline_info.renderPass = render_pass;
   pipeline_info.subpass = 0;
 
-  result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info,
-                                     nullptr, &pipeline_);
-  if (result != VK_SUCCESS) {
-    spdlog::error("pipeline creation failed");
-    return result;
+  // one pipeline per vertex format, meshes bind the one of their buffers;
+  // timed to see what the cache saves at startup and on resize
+  auto start = std::chrono::steady_clock::now();
+  for (int format = 0; format < VERTEX_FORMAT_NUM; ++format) {
+    auto binding_descs =
+        RenderMesh::GetBindDescription(VertexFormat(format));
+    auto attr_descs =
+        RenderMesh::GetAttributeDescriptions(VertexFormat(format));
+    vertex_input_info.vertexBindingDescriptionCount =
+        static_cast<uint32_t>(binding_descs.size());
+    vertex_input_info.pVertexBindingDescriptions = binding_descs.data();
+    vertex_input_info.vertexAttributeDescriptionCount =
+        static_cast<uint32_t>(attr_descs.size());
+    vertex_input_info.pVertexAttributeDescriptions = attr_descs.data();
+    compact = format == VERTEX_FORMAT_COMPACT ? VK_TRUE : VK_FALSE;
+
+    result = vkCreateGraphicsPipelines(device, cache, 1, &pipeline_info,
+                                       nullptr, &pipelines_[format]);
+    if (result != VK_SUCCESS) {
+      spdlog::error("pipeline creation failed");
+      return result;
+    }
   }
+  std::chrono::duration<double, std::milli> time =
+      std::chrono::steady_clock::now() - start;
+  spdlog::info("{} graphics pipelines created in {:.2f} ms",
+               int(VERTEX_FORMAT_NUM), time.count());
 
   if (shader_) {
     shader_->Destroy(device);
@@ -159,8 +188,11 @@ void Pipeline::Destroy(VkDevice device) {
   if (layout_ != VK_NULL_HANDLE) {
     vkDestroyPipelineLayout(device, layout_, nullptr);
   }
-  if (pipeline_ != VK_NULL_HANDLE) {
-    vkDestroyPipeline(device, pipeline_, nullptr);
+  for (auto& pipeline : pipelines_) {
+    if (pipeline != VK_NULL_HANDLE) {
+      vkDestroyPipeline(device, pipeline, nullptr);
+      pipeline = VK_NULL_HANDLE;
+    }
   }
 }
 };  // namespace Rain
\ No newline at end of file
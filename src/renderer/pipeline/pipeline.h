@@ -11,10 +11,11 @@ class Pipeline {
  public:
   Shader* shader_ = nullptr;
   VkPipelineLayout layout_ = VK_NULL_HANDLE;
-  VkPipeline pipeline_;
+  VkPipeline pipelines_[VERTEX_FORMAT_NUM] = {};  // per vertex format
 
-  VkResult Init(VkDevice device, const VkExtent2D& extent,
-                VkRenderPass render_pass, RenderScene* scene);
+  VkResult Init(VkDevice device, VkPipelineCache cache,
+                const VkExtent2D& extent, VkRenderPass render_pass,
+                RenderScene* scene);
   void Destroy(VkDevice device);
 };
 };  // namespace Rain
\ No newline at end of file
@@ -1,71 +1,160 @@
 #include "renderscene.h"
 
+#include <algorithm>
 #include <array>
+#include <cstring>
+
+#include "quantize.h"
 
 namespace Rain {
+namespace {
+// the draw structs have no padding
+template <typename T>
+bool SameBytes(const std::vector<T>& a, const std::vector<T>& b) {
+  return a.size() == b.size() &&
+         (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+}  // namespace
+
+void RenderMesh::Init(const MeshHandle& mesh, VertexFormat vertex_format) {
+  mesh_ = mesh;
+  vertex_format_ = vertex_format;
+}
 
-void RenderModel::Init(Object* obj) {
+void RenderModel::Init(Object* obj, uint32_t mesh) {
   obj_ = obj;
-  uniform_data_.Ka_d_.segment<3>(0) = obj_->material_.Ka_;
-  uniform_data_.Ka_d_[3] = obj_->material_.d_;
-  uniform_data_.Kd_.segment<3>(0) = obj_->material_.Kd_;
-  uniform_data_.Ks_Ns_.segment<3>(0) = obj_->material_.Ks_;
-  uniform_data_.Ks_Ns_[3] = obj_->material_.Ns_;
-  uniform_data_.model_ = obj_->transformation_;
+  mesh_ = mesh;
+  const MeshAsset& asset = *obj_->mesh_;
+  instance_data_.model_ = obj_->transformation_;
+  instance_data_.bbox_min_.segment<3>(0) = asset.bbox_min_;
+  instance_data_.bbox_extent_.segment<3>(0) =
+      Quantize::Extent(asset.bbox_min_, asset.bbox_max_);
+  material_data_.resize(asset.ranges_.size());
+  for (size_t i = 0; i < asset.ranges_.size(); ++i) {
+    const Material& mat = obj_->GetMaterial(asset.ranges_[i]);
+    MaterialData& data = material_data_[i];
+    data.Ka_d_.segment<3>(0) = mat.Ka_;
+    data.Ka_d_[3] = mat.d_;
+    data.Kd_.segment<3>(0) = mat.Kd_;
+    data.Ks_Ns_.segment<3>(0) = mat.Ks_;
+    data.Ks_Ns_[3] = mat.Ns_;
+  }
 }
 
-VkResult RenderModel::CreateBuffers(Device* device) {
-  uint64_t size;
-  VkResult result;
+void RenderMesh::BuildSubMeshes(std::vector<uint16_t>& indices16) {
+  const MeshAsset* asset = mesh_.get();
+  const uint32_t* indices = asset->surface_indices_;
+  submeshes_.clear();
+  indices16.clear();
+  index_type_ = VK_INDEX_TYPE_UINT32;
+  for (uint32_t r = 0; r < uint32_t(asset->ranges_.size()); ++r) {
+    const DrawRange& range = asset->ranges_[r];
+    uint64_t end = range.first_index_ + range.n_index_;
+    uint64_t first = range.first_index_;
+    while (first < end) {
+      // grow while the vertices stay within 64K of each other, vertices are
+      // in first use order so a sub-mesh covers a run of them
+      uint32_t lo = UINT32_MAX, hi = 0;
+      uint64_t last = first;
+      for (; last < end; last += 3) {
+        uint32_t tri_lo = std::min({indices[last], indices[last + 1],
+                                    indices[last + 2]});
+        uint32_t tri_hi = std::max({indices[last], indices[last + 1],
+                                    indices[last + 2]});
+        if (std::max(hi, tri_hi) - std::min(lo, tri_lo) > UINT16_MAX) break;
+        lo = std::min(lo, tri_lo);
+        hi = std::max(hi, tri_hi);
+      }
+      if (last == first) {
+        // one triangle spans more than 64K vertices
+        submeshes_.clear();
+        indices16.clear();
+        for (uint32_t i = 0; i < uint32_t(asset->ranges_.size()); ++i) {
+          submeshes_.push_back(
+              {uint32_t(asset->ranges_[i].first_index_),
+               uint32_t(asset->ranges_[i].n_index_), 0, i});
+        }
+        return;
+      }
+      submeshes_.push_back(
+          {uint32_t(first), uint32_t(last - first), int32_t(lo), r});
+      first = last;
+    }
+  }
+  index_type_ = VK_INDEX_TYPE_UINT16;
+  indices16.resize(asset->n_surfidx_);
+  for (const SubMesh& submesh : submeshes_) {
+    for (uint32_t i = submesh.first_index_;
+         i < submesh.first_index_ + submesh.n_index_; ++i) {
+      indices16[i] = uint16_t(indices[i] - uint32_t(submesh.vertex_offset_));
+    }
+  }
+}
 
-  // vertex buffers
-  vertex_buffers_.resize(2);
-  size = (uint64_t)(sizeof(Vec3f)) * obj_->n_vert_;
-  result = vertex_buffers_[0].AllocateDeviceLocal(
-      device, obj_->vertices_, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-  if (result != VK_SUCCESS) return result;
+VkResult RenderMesh::CreateBuffers(Device* device, GeometryPool& vertex_pool,
+                                   GeometryPool* index_pools) {
+  const MeshAsset* asset = mesh_.get();
+  VkResult result;
 
-  size = (uint64_t)(sizeof(Vec3f)) * obj_->n_vert_;
-  result = vertex_buffers_[1].AllocateDeviceLocal(
-      device, obj_->normals_, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+  // vertices
+  std::vector<Quantize::Position> positions;
+  std::vector<Quantize::Normal> normals;
+  std::vector<const void*> streams = {asset->vertices_, asset->normals_};
+  if (vertex_format_ == VERTEX_FORMAT_COMPACT) {
+    positions.resize(asset->n_vert_);
+    Quantize::EncodePositions(
+        asset->n_vert_, asset->vertices_, asset->bbox_min_,
+        Quantize::Extent(asset->bbox_min_, asset->bbox_max_), positions.data());
+    normals.resize(asset->n_vert_);
+    Quantize::EncodeNormals(asset->n_vert_, asset->normals_, normals.data());
+    streams = {positions.data(), normals.data()};
+  }
+  result = vertex_pool.Allocate(device, asset->n_vert_, streams,
+                                first_vertex_, vertex_node_);
   if (result != VK_SUCCESS) return result;
 
-  vertex_vkbuffers_.clear();
-  for (auto buffer : vertex_buffers_) {
-    vertex_vkbuffers_.push_back(buffer.buffer_);
-  }
-  vertex_vkbuffer_offsets_.clear();
-  for (int i = 0; i < vertex_buffers_.size(); ++i) {
-    vertex_vkbuffer_offsets_.push_back(0);
+  // indices
+  std::vector<uint16_t> indices16;
+  BuildSubMeshes(indices16);
+  const void* indices = indices16.data();
+  if (index_type_ != VK_INDEX_TYPE_UINT16) {
+    spdlog::warn("{} vertices can not be split for 16-bit indices",
+                 asset->n_vert_);
+    indices = asset->surface_indices_;
   }
-
-  // index buffer
-  size = (uint64_t)(sizeof(uint32_t)) * obj_->n_surfidx_;
-  result = index_buffer_.AllocateDeviceLocal(
-      device, obj_->surface_indices_, size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+  result = index_pools[IndexPoolOf(index_type_)].Allocate(
+      device, asset->n_surfidx_, {indices}, first_index_, index_node_);
   if (result != VK_SUCCESS) return result;
 
+  // the draws address the pools
+  for (SubMesh& submesh : submeshes_) {
+    submesh.first_index_ += uint32_t(first_index_);
+    submesh.vertex_offset_ += int32_t(first_vertex_);
+  }
   return VK_SUCCESS;
 }
 
-void RenderModel::Destroy(VkDevice device) {
-  for (auto buffer : vertex_buffers_) {
-    buffer.Destroy(device);
-  }
-  index_buffer_.Destroy(device);
+void RenderMesh::FreeBuffers(GeometryPool& vertex_pool,
+                             GeometryPool* index_pools) {
+  vertex_pool.Free(vertex_node_);
+  index_pools[IndexPoolOf(index_type_)].Free(index_node_);
+  vertex_node_ = RangeAllocator::NULL_NODE;
+  index_node_ = RangeAllocator::NULL_NODE;
 }
 
-std::vector<VkVertexInputBindingDescription> RenderModel::GetBindDescription() {
+std::vector<VkVertexInputBindingDescription> RenderMesh::GetBindDescription(
+    VertexFormat vertex_format) {
+  bool compact = vertex_format == VERTEX_FORMAT_COMPACT;
   std::vector<VkVertexInputBindingDescription> ret;
   VkVertexInputBindingDescription vertices_desc;
   vertices_desc.binding = 0;
-  vertices_desc.stride = sizeof(Vec3f);
+  vertices_desc.stride = compact ? sizeof(Quantize::Position) : sizeof(Vec3f);
   vertices_desc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
   ret.push_back(vertices_desc);
 
   VkVertexInputBindingDescription normals_desc;
   normals_desc.binding = 1;
-  normals_desc.stride = sizeof(Vec3f);
+  normals_desc.stride = compact ? sizeof(Quantize::Normal) : sizeof(Vec3f);
   normals_desc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
   ret.push_back(normals_desc);
 
@@ -73,19 +162,22 @@ std::vector<VkVertexInputBindingDescription> RenderModel::GetBindDescription() {
 }
 
 std::vector<VkVertexInputAttributeDescription>
-RenderModel::GetAttributeDescriptions() {
+RenderMesh::GetAttributeDescriptions(VertexFormat vertex_format) {
+  bool compact = vertex_format == VERTEX_FORMAT_COMPACT;
   std::vector<VkVertexInputAttributeDescription> ret;
   VkVertexInputAttributeDescription vertices_desc;
   vertices_desc.binding = 0;
   vertices_desc.location = 0;
-  vertices_desc.format = VK_FORMAT_R32G32B32_SFLOAT;
+  vertices_desc.format = compact ? VK_FORMAT_R16G16B16A16_UNORM
+                                 : VK_FORMAT_R32G32B32_SFLOAT;
   vertices_desc.offset = 0;
   ret.push_back(vertices_desc);
 
   VkVertexInputAttributeDescription normals_desc;
   normals_desc.binding = 1;
   normals_desc.location = 1;
-  normals_desc.format = VK_FORMAT_R32G32B32_SFLOAT;
+  normals_desc.format =
+      compact ? VK_FORMAT_R16G16_SNORM : VK_FORMAT_R32G32B32_SFLOAT;
   normals_desc.offset = 0;
   ret.push_back(normals_desc);
 
@@ -95,24 +187,24 @@ RenderModel::GetAttributeDescriptions() {
 VkResult RenderScene::Init(Device* device, SwapChain* swap_chain,
                            Scene* scene) {
   VkResult result;
+  scene_ = scene;
+  multi_draw_indirect_ = device->features_.multiDrawIndirect &&
+                         device->features_.drawIndirectFirstInstance;
+  draw_indexed_indirect_count_ = device->draw_indexed_indirect_count_;
+  // meshes may still be loading, their buffers are created once resident
   models_.resize(scene->objects_.size());
-  uint32_t offset = 0;
-  for (size_t i = 0; i < models_.size(); ++i) {
-    models_[i].Init(&scene->objects_[i]);
-    models_[i].ubo_offset_ = offset;
-    models_[i].ubo_size_ = sizeof(ModelUniformData);
-    offset += device->GetAlignedUniformByteOffset(sizeof(ModelUniformData));
-    result = models_[i].CreateBuffers(device);
-    if (result != VK_SUCCESS) {
-      spdlog::error("model buffer creation failed");
-      return result;
+  bounds_.Resize(models_.size());
+  for (uint32_t i = 0; i < VERTEX_FORMAT_NUM; ++i) {
+    std::vector<uint32_t> strides;
+    for (auto& binding : RenderMesh::GetBindDescription(VertexFormat(i))) {
+      strides.push_back(binding.stride);
     }
+    vertex_pools_[i].Init(strides, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
   }
-  model_ubo_size_ = offset;
-  model_ubo_data_ = new uint8_t[model_ubo_size_];
+  index_pools_[0].Init({sizeof(uint16_t)}, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+  index_pools_[1].Init({sizeof(uint32_t)}, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
   for (size_t i = 0; i < models_.size(); ++i) {
-    memcpy(model_ubo_data_ + models_[i].ubo_offset_, &models_[i].uniform_data_,
-           sizeof(ModelUniformData));
+    models_[i].obj_ = &scene->objects_[i];
   }
   camera_ = new Camera;
   float aspect = 1.0;
@@ -120,6 +212,10 @@ VkResult RenderScene::Init(Device* device, SwapChain* swap_chain,
     aspect = float(swap_chain->extent_.width) / swap_chain->extent_.height;
   camera_->InitData(aspect, 0.25f * PI_, 1.0f, 1000.0f, 3.0f, 0.0f, 0.3f * PI_,
                     Vec3::Zero());
+  result = culler_.Init(device, swap_chain->MAX_FRAMES_IN_FLIGHT);
+  if (result != VK_SUCCESS) {
+    return result;
+  }
   result = InitUniform(device, swap_chain);
   if (result != VK_SUCCESS) {
     return result;
@@ -128,88 +224,484 @@ VkResult RenderScene::Init(Device* device, SwapChain* swap_chain,
 }
 
 VkResult RenderScene::InitUniform(Device* device, SwapChain* swap_chain) {
+  // a region is rewritten once the fence of its frame is signaled
+  n_frame_ = swap_chain->MAX_FRAMES_IN_FLIGHT;
+  global_size_ = device->GetAlignedStorageByteOffset(
+      device->GetAlignedUniformByteOffset(sizeof(GlobalUniformData)));
+  VkResult result = InitModelUniform(device);
+  if (result != VK_SUCCESS) {
+    return result;
+  }
+
+  return VK_SUCCESS;
+}
+
+VkResult RenderScene::InitModelUniform(Device* device) {
   VkResult result;
-  n_swap_image_ = swap_chain->images_.size();
-
-  // global
-  VkDeviceSize size = sizeof(GlobalUniformData);
-  global_ubs_.resize(n_swap_image_);
-  for (size_t i = 0; i < n_swap_image_; ++i) {
-    result = global_ubs_[i].Allocate(device, nullptr, size,
-                                     VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+  // slots move and the ring or its descriptors may be replaced
+  ++draw_version_;
+  // instances of a mesh take adjacent slots, so that one draw covers them
+  n_instance_ = 0;
+  n_material_ = 0;
+  n_command_ = 0;
+  n_range_ = 0;
+  for (auto& mesh : meshes_) {
+    mesh.first_instance_ = n_instance_;
+    mesh.first_material_ = n_material_;
+    mesh.first_range_ = n_range_;
+    for (uint32_t i = 0; i < uint32_t(mesh.instances_.size()); ++i) {
+      RenderModel& model = models_[mesh.instances_[i]];
+      model.instance_ = i;
+      model.dirty_frames_ = n_frame_;
+    }
+    n_instance_ += uint32_t(mesh.instances_.size());
+    n_material_ +=
+        uint32_t(mesh.instances_.size() * mesh.mesh_->ranges_.size());
+    n_command_ += uint32_t(mesh.submeshes_.size());
+    n_range_ += uint32_t(mesh.mesh_->ranges_.size());
+  }
+  bool grown = uniform_ring_.frame_size_ == 0 ||
+               n_instance_ > instance_capacity_ ||
+               n_material_ > material_capacity_ ||
+               n_command_ > command_capacity_ || n_range_ > range_capacity_;
+  if (grown) {
+    // keep one slot so that nothing is empty before the first model arrives
+    instance_capacity_ = std::max(n_instance_, 1u);
+    material_capacity_ = std::max(n_material_, 1u);
+    command_capacity_ = std::max(n_command_, 1u);
+    range_capacity_ = std::max(n_range_, 1u);
+    if (uniform_ring_.frame_size_) {
+      // room for the next models too, frames in flight may still read the
+      // old ring
+      vkQueueWaitIdle(device->graphics_queue_);
+      instance_capacity_ += instance_capacity_ / 2;
+      material_capacity_ += material_capacity_ / 2;
+      command_capacity_ += command_capacity_ / 2;
+      range_capacity_ += range_capacity_ / 2;
+    }
+    material_offset_ =
+        global_size_ + device->GetAlignedStorageByteOffset(
+                           instance_capacity_ * sizeof(InstanceData));
+    // at most one draw slot per material slot
+    slot_offset_ = material_offset_ +
+                   device->GetAlignedStorageByteOffset(
+                       material_capacity_ * sizeof(MaterialData));
+    command_offset_ = slot_offset_ + device->GetAlignedStorageByteOffset(
+                                         material_capacity_ * sizeof(uint32_t));
+    // the areas of the GPU culling, written whether or not it is on
+    cull_offset_ =
+        command_offset_ +
+        device->GetAlignedUniformByteOffset(device->GetAlignedStorageByteOffset(
+            command_capacity_ * sizeof(VkDrawIndexedIndirectCommand)));
+    state_offset_ = cull_offset_ + device->GetAlignedStorageByteOffset(
+                                       sizeof(CullUniformData));
+    template_offset_ =
+        state_offset_ +
+        device->GetAlignedStorageByteOffset(
+            sizeof(CullState) + range_capacity_ * sizeof(RangeData));
+    uniform_ring_.Destroy(device->device_);
+    culled_frames_ = 0;
+    result = uniform_ring_.Init(
+        device, n_frame_,
+        template_offset_ + command_capacity_ * sizeof(DrawTemplate));
     if (result != VK_SUCCESS) {
+      spdlog::error("uniform ring creation failed");
       return result;
     }
   }
-  // model
-  model_ubs_.resize(n_swap_image_);
-  for (size_t i = 0; i < n_swap_image_; ++i) {
-    result = model_ubs_[i].AllocateDeviceLocal(
-        device, model_ubo_data_, model_ubo_size_,
-        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+  if (set_ == VK_NULL_HANDLE) {
+    result = InitDescriptor(device);
     if (result != VK_SUCCESS) {
       return result;
     }
+    UpdateDescriptor(device);
+  } else if (grown) {
+    UpdateDescriptor(device);
   }
 
-  result = InitDescriptor(device);
+  return VK_SUCCESS;
+}
+
+VkResult RenderScene::UpdateResidency(Device* device) {
+  VkResult result;
+  bool changed = false;
+  for (size_t i = 0; i < models_.size(); ++i) {
+    if (models_[i].resident_ || !scene_->IsLoaded(i)) continue;
+    // instances of an uploaded mesh only need their uniforms
+    const MeshHandle& mesh = scene_->objects_[i].mesh_;
+    auto it = mesh_ids_.find(mesh.get());
+    if (it == mesh_ids_.end()) {
+      RenderMesh render_mesh;
+      render_mesh.Init(mesh, vertex_format_);
+      result = render_mesh.CreateBuffers(
+          device, vertex_pools_[vertex_format_], index_pools_);
+      if (result != VK_SUCCESS) {
+        // the vertices may have a range already
+        render_mesh.FreeBuffers(vertex_pools_[vertex_format_], index_pools_);
+        spdlog::error("mesh buffer creation failed");
+        return result;
+      }
+      it = mesh_ids_.emplace(mesh.get(), uint32_t(meshes_.size())).first;
+      meshes_.push_back(render_mesh);
+    }
+    models_[i].Init(&scene_->objects_[i], it->second);
+    models_[i].resident_ = true;
+    scene_->objects_[i].UpdateBounds();
+    bounds_.Set(i, scene_->objects_[i].bbox_min_,
+                scene_->objects_[i].bbox_max_);
+    meshes_[it->second].instances_.push_back(uint32_t(i));
+    changed = true;
+  }
+  if (!changed) return VK_SUCCESS;
+
+  // one batch for the meshes uploaded above, the next frame is ordered
+  // after it on the GPU
+  result = device->uploader_.Submit();
   if (result != VK_SUCCESS) {
     return result;
   }
+  // the slots move, regions are only written once their frame is done so
+  // frames in flight keep reading the old layout
+  return InitModelUniform(device);
+}
 
-  return VK_SUCCESS;
+void RenderScene::UpdateModel(size_t model_index) {
+  RenderModel& model = models_[model_index];
+  if (!model.resident_) return;
+  model.Init(model.obj_, model.mesh_);
+  model.dirty_frames_ = n_frame_;
+  model.obj_->UpdateBounds();
+  bounds_.Set(model_index, model.obj_->bbox_min_, model.obj_->bbox_max_);
 }
 
-void RenderScene::UpdateUniform(VkDevice device, uint32_t image_index) {
+void RenderScene::UpdateUniform(VkDevice device, uint32_t frame) {
   camera_->UpdateData();
   float theta = light_x_angle_ / 180 * PI_;
   float phi = light_y_angle_ / 180 * PI_;
   light_direction_ = -Vec3f(-cos(phi)*cos(theta), sin(phi), cos(phi)*sin(theta));
-  void* data;
   GlobalUniformData global_data;
   global_data.proj_view = camera_->proj_view_;
   global_data.ambient = ambient_light_;
   global_data.directional = directional_light_;
   global_data.light_direction = light_direction_;
-  vkMapMemory(device, global_ubs_[image_index].memory_, 0,
-              sizeof(GlobalUniformData), 0, &data);
-  memcpy(data, &global_data, sizeof(GlobalUniformData));
-  vkUnmapMemory(device, global_ubs_[image_index].memory_);
+  uniform_ring_.Write(frame, 0, &global_data, sizeof(GlobalUniformData));
+  // a changed model is rewritten in the region of each frame in turn
+  for (auto& model : models_) {
+    if (!model.resident_ || model.dirty_frames_ == 0) continue;
+    const RenderMesh& mesh = meshes_[model.mesh_];
+    uint32_t instance = mesh.first_instance_ + model.instance_;
+    uint32_t n_instance = uint32_t(mesh.instances_.size());
+    model.instance_data_.first_range_ = mesh.first_range_;
+    model.instance_data_.n_range_ = uint32_t(model.material_data_.size());
+    model.instance_data_.first_material_ =
+        mesh.first_material_ + model.instance_;
+    model.instance_data_.stride_ = n_instance;
+    uniform_ring_.Write(frame, global_size_ + instance * sizeof(InstanceData),
+                        &model.instance_data_, sizeof(InstanceData));
+    for (uint32_t r = 0; r < uint32_t(model.material_data_.size()); ++r) {
+      MaterialData& data = model.material_data_[r];
+      data.instance_ = instance;
+      uint32_t slot = mesh.first_material_ + r * n_instance + model.instance_;
+      uniform_ring_.Write(frame, material_offset_ + slot * sizeof(MaterialData),
+                          &data, sizeof(MaterialData));
+    }
+    --model.dirty_frames_;
+  }
+  if (gpu_culling_) {
+    // the counters of the last frame drawn from this region, its fence is
+    // signaled
+    if (culled_frames_ & (1u << frame)) {
+      CullState state;
+      if (uniform_ring_.Read(device, frame, state_offset_, &state,
+                             sizeof(CullState)) == VK_SUCCESS) {
+        cull_stats_.n_tested_ = state.n_tested_;
+        cull_stats_.n_culled_ = state.n_frustum_ + state.n_occluded_;
+        cull_stats_.n_occluded_ = state.n_occluded_;
+      }
+    }
+    BuildTemplates(frame);
+  } else {
+    BuildDraws(frame);
+  }
+  UpdateDrawVersion();
+  uniform_ring_.Flush(device);
+}
+
+void RenderScene::UpdateDrawVersion() {
+  // the indirect draws read their arguments from the ring, only the
+  // direct ones are recorded with them
+  if (drawn_gpu_culling_ == gpu_culling_ &&
+      SameBytes(drawn_batches_, batches_) &&
+      (multi_draw_indirect_ || SameBytes(drawn_commands_, commands_))) {
+    return;
+  }
+  ++draw_version_;
+  drawn_gpu_culling_ = gpu_culling_;
+  drawn_batches_ = batches_;
+  if (!multi_draw_indirect_) drawn_commands_ = commands_;
+}
+
+void RenderScene::BindDescriptor(VkCommandBuffer command_buffer,
+                                 VkPipelineLayout layout, uint32_t frame) {
+  uint32_t offsets[4] = {
+      uint32_t(uniform_ring_.GetOffset(frame, 0)),
+      uint32_t(uniform_ring_.GetOffset(frame, global_size_)),
+      uint32_t(uniform_ring_.GetOffset(frame, material_offset_)),
+      uint32_t(uniform_ring_.GetOffset(frame, slot_offset_))};
+  vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          layout, 0, 1, &set_, 4, offsets);
+}
+
+void RenderScene::BuildDraws(uint32_t frame) {
+  // the pyramid and the counters go stale while the CPU culls
+  culler_.pyramid_valid_ = false;
+  culled_frames_ = 0;
+  if (culling_) {
+    Culling::Cull(bounds_, camera_->frustum_, visible_);
+  } else {
+    visible_.resize(models_.size());
+    for (uint32_t i = 0; i < uint32_t(models_.size()); ++i) visible_[i] = i;
+  }
+  // visible instances grouped by mesh, a counting sort on the mesh index
+  visible_offsets_.assign(meshes_.size() + 1, 0);
+  cull_stats_ = CullStats();
+  for (uint32_t i : visible_) {
+    if (models_[i].resident_) ++visible_offsets_[models_[i].mesh_ + 1];
+  }
+  for (size_t m = 0; m < meshes_.size(); ++m) {
+    visible_offsets_[m + 1] += visible_offsets_[m];
+  }
+  // Cull goes over every slot of the table, resident or not
+  if (culling_) {
+    cull_stats_.n_tested_ = uint32_t(bounds_.size_);
+    cull_stats_.n_culled_ = uint32_t(bounds_.size_ - visible_.size());
+  }
+  visible_instances_.resize(visible_offsets_.back());
+  std::vector<uint32_t> cursor(visible_offsets_.begin(),
+                               visible_offsets_.end() - 1);
+  for (uint32_t i : visible_) {
+    const RenderModel& model = models_[i];
+    if (!model.resident_) continue;
+    visible_instances_[cursor[model.mesh_]++] = model.instance_;
+  }
+
+  commands_.clear();
+  batches_.clear();
+  draw_slots_.clear();
+  const VkIndexType index_types[2] = {VK_INDEX_TYPE_UINT16,
+                                      VK_INDEX_TYPE_UINT32};
+  for (uint32_t format = 0; format < VERTEX_FORMAT_NUM; ++format) {
+    for (VkIndexType index_type : index_types) {
+      DrawBatch batch{VertexFormat(format), index_type,
+                      uint32_t(commands_.size()), 0, 0};
+      for (size_t m = 0; m < meshes_.size(); ++m) {
+        const RenderMesh& mesh = meshes_[m];
+        uint32_t first_visible = visible_offsets_[m];
+        uint32_t n_visible = visible_offsets_[m + 1] - first_visible;
+        if (mesh.vertex_format_ != batch.vertex_format_ ||
+            mesh.index_type_ != index_type || n_visible == 0)
+          continue;
+        // the draws of a range read the material slots of its visible
+        // instances through their instance index
+        uint32_t n_instance = uint32_t(mesh.instances_.size());
+        uint32_t slot_range = UINT32_MAX;
+        uint32_t first_slot = 0;
+        for (const SubMesh& submesh : mesh.submeshes_) {
+          if (submesh.range_ != slot_range) {
+            slot_range = submesh.range_;
+            first_slot = uint32_t(draw_slots_.size());
+            for (uint32_t v = first_visible; v < first_visible + n_visible;
+                 ++v) {
+              draw_slots_.push_back(mesh.first_material_ +
+                                    slot_range * n_instance +
+                                    visible_instances_[v]);
+            }
+          }
+          VkDrawIndexedIndirectCommand command;
+          command.indexCount = submesh.n_index_;
+          command.instanceCount = n_visible;
+          command.firstIndex = submesh.first_index_;
+          command.vertexOffset = submesh.vertex_offset_;
+          command.firstInstance = first_slot;
+          commands_.push_back(command);
+        }
+      }
+      batch.n_command_ = uint32_t(commands_.size()) - batch.first_command_;
+      if (batch.n_command_) batches_.push_back(batch);
+    }
+  }
+  if (!draw_slots_.empty()) {
+    uniform_ring_.Write(frame, slot_offset_, draw_slots_.data(),
+                        draw_slots_.size() * sizeof(uint32_t));
+  }
+  if (multi_draw_indirect_ && !commands_.empty()) {
+    uniform_ring_.Write(
+        frame, command_offset_, commands_.data(),
+        commands_.size() * sizeof(VkDrawIndexedIndirectCommand));
+  }
 }
 
-void RenderScene::BindAndDraw(VkCommandBuffer command_buffer,
-                              VkPipelineLayout layout, uint32_t image_index,
-                              uint32_t model_index) {
-  vkCmdBindVertexBuffers(command_buffer, 0,
-                         models_[model_index].vertex_vkbuffers_.size(),
-                         models_[model_index].vertex_vkbuffers_.data(),
-                         models_[model_index].vertex_vkbuffer_offsets_.data());
-  vkCmdBindIndexBuffer(command_buffer,
-                       models_[model_index].index_buffer_.buffer_, 0,
-                       VK_INDEX_TYPE_UINT32);
-  vkCmdBindDescriptorSets(
-      command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1,
-      &sets_[image_index * models_.size() + model_index], 0, nullptr);
-  vkCmdDrawIndexed(command_buffer,
-                   static_cast<uint32_t>(models_[model_index].obj_->n_surfidx_),
-                   1, 0, 0, 0);
+void RenderScene::BuildTemplates(uint32_t frame) {
+  // the draw slots of a range are where its material slots are, with room
+  // for every instance
+  ranges_.resize(n_range_);
+  for (const RenderMesh& mesh : meshes_) {
+    uint32_t n_instance = uint32_t(mesh.instances_.size());
+    for (uint32_t r = 0; r < uint32_t(mesh.mesh_->ranges_.size()); ++r) {
+      ranges_[mesh.first_range_ + r] = {mesh.first_material_ + r * n_instance,
+                                        0};
+    }
+  }
+  templates_.clear();
+  commands_.clear();
+  batches_.clear();
+  const VkIndexType index_types[2] = {VK_INDEX_TYPE_UINT16,
+                                      VK_INDEX_TYPE_UINT32};
+  for (uint32_t format = 0; format < VERTEX_FORMAT_NUM; ++format) {
+    for (VkIndexType index_type : index_types) {
+      DrawBatch batch{VertexFormat(format), index_type,
+                      uint32_t(templates_.size()), 0,
+                      uint32_t(batches_.size())};
+      for (const RenderMesh& mesh : meshes_) {
+        if (mesh.vertex_format_ != batch.vertex_format_ ||
+            mesh.index_type_ != index_type || mesh.instances_.empty())
+          continue;
+        for (const SubMesh& submesh : mesh.submeshes_) {
+          templates_.push_back({submesh.n_index_, submesh.first_index_,
+                                submesh.vertex_offset_,
+                                mesh.first_range_ + submesh.range_,
+                                batch.count_, batch.first_command_});
+        }
+      }
+      batch.n_command_ = uint32_t(templates_.size()) - batch.first_command_;
+      if (batch.n_command_) batches_.push_back(batch);
+    }
+  }
+  // the counters start from zero, the GPU adds the culled instances to them
+  CullState state{};
+  state.n_tested_ = n_instance_;
+  uniform_ring_.Write(frame, state_offset_, &state, sizeof(CullState));
+  if (!ranges_.empty()) {
+    uniform_ring_.Write(frame, state_offset_ + sizeof(CullState),
+                        ranges_.data(), ranges_.size() * sizeof(RangeData));
+  }
+  if (!templates_.empty()) {
+    uniform_ring_.Write(frame, template_offset_, templates_.data(),
+                        templates_.size() * sizeof(DrawTemplate));
+  }
+  CullUniformData cull_data;
+  for (int p = 0; p < 6; ++p) cull_data.planes_[p] = camera_->frustum_[p];
+  cull_data.pyramid_proj_view_ = culler_.pyramid_proj_view_;
+  cull_data.pyramid_size_ = Vec4f::Zero();
+  if (!culler_.depth_images_.empty()) {
+    cull_data.pyramid_size_ =
+        Vec4f(float(culler_.depth_images_[0]->width_),
+              float(culler_.depth_images_[0]->height_),
+              float(culler_.pyramid_.mip_levels_),
+              occlusion_culling_ && culler_.pyramid_valid_ ? 1.0f : 0.0f);
+  }
+  cull_data.n_instance_ = n_instance_;
+  cull_data.n_template_ = uint32_t(templates_.size());
+  cull_data.frustum_ = culling_ ? 1 : 0;
+  uniform_ring_.Write(frame, cull_offset_, &cull_data,
+                      sizeof(CullUniformData));
+}
+
+void RenderScene::RecordCulling(VkCommandBuffer command_buffer,
+                                uint32_t frame) {
+  if (!gpu_culling_) return;
+  culler_.RecordCulling(command_buffer, frame, n_instance_,
+                        uint32_t(templates_.size()));
+  culled_frames_ |= 1u << frame;
+}
+
+void RenderScene::RecordDepthPyramid(VkCommandBuffer command_buffer,
+                                     uint32_t image_index) {
+  if (!gpu_culling_) return;
+  culler_.RecordPyramid(command_buffer, image_index, camera_->proj_view_);
+}
+
+void RenderScene::SplitDraws(uint32_t max_chunk,
+                             std::vector<DrawBatch>& chunks) const {
+  if (multi_draw_indirect_) {
+    chunks = batches_;
+    return;
+  }
+  uint32_t n_draw = 0;
+  for (const DrawBatch& batch : batches_) n_draw += batch.n_command_;
+  max_chunk = std::max(max_chunk, 1u);
+  uint32_t chunk_size =
+      std::max(MIN_CHUNK_DRAWS, (n_draw + max_chunk - 1) / max_chunk);
+  chunks.clear();
+  for (const DrawBatch& batch : batches_) {
+    for (uint32_t first = 0; first < batch.n_command_; first += chunk_size) {
+      DrawBatch chunk = batch;
+      chunk.first_command_ += first;
+      chunk.n_command_ = std::min(chunk_size, batch.n_command_ - first);
+      chunks.push_back(chunk);
+    }
+  }
+}
+
+void RenderScene::Draw(VkCommandBuffer command_buffer, uint32_t frame,
+                       const DrawBatch& batch) {
+  if (gpu_culling_ && draw_indexed_indirect_count_) {
+    draw_indexed_indirect_count_(
+        command_buffer, uniform_ring_.buffer_.buffer_,
+        uniform_ring_.GetOffset(
+            frame, command_offset_ + batch.first_command_ *
+                                         sizeof(VkDrawIndexedIndirectCommand)),
+        uniform_ring_.buffer_.buffer_,
+        uniform_ring_.GetOffset(frame,
+                                state_offset_ + batch.count_ * sizeof(uint32_t)),
+        batch.n_command_, sizeof(VkDrawIndexedIndirectCommand));
+    return;
+  }
+  if (multi_draw_indirect_) {
+    vkCmdDrawIndexedIndirect(
+        command_buffer, uniform_ring_.buffer_.buffer_,
+        uniform_ring_.GetOffset(
+            frame, command_offset_ + batch.first_command_ *
+                                         sizeof(VkDrawIndexedIndirectCommand)),
+        batch.n_command_, sizeof(VkDrawIndexedIndirectCommand));
+    return;
+  }
+  for (uint32_t i = batch.first_command_;
+       i < batch.first_command_ + batch.n_command_; ++i) {
+    const VkDrawIndexedIndirectCommand& command = commands_[i];
+    vkCmdDrawIndexed(command_buffer, command.indexCount, command.instanceCount,
+                     command.firstIndex, command.vertexOffset,
+                     command.firstInstance);
+  }
 }
 
 VkResult RenderScene::InitDescriptor(Device* device) {
   VkResult result;
-  uint32_t n_uniform = n_uniform_buffer_ + n_uniform_texture_;
+  uint32_t n_uniform =
+      n_uniform_buffer_ + n_storage_buffer_ + n_uniform_texture_;
   std::vector<VkDescriptorSetLayoutBinding> uniform_bindings;
   uniform_bindings.resize(n_uniform);
   uint32_t idx = 0;
   for (uint32_t i = 0; i < n_uniform_buffer_; ++i) {
     uniform_bindings[idx].binding = idx;
     uniform_bindings[idx].descriptorCount = 1;
-    uniform_bindings[idx].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    uniform_bindings[idx].descriptorType =
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     uniform_bindings[idx].pImmutableSamplers = nullptr;
     uniform_bindings[idx].stageFlags =
         VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
     ++idx;
   }
+  for (uint32_t i = 0; i < n_storage_buffer_; ++i) {
+    uniform_bindings[idx].binding = idx;
+    uniform_bindings[idx].descriptorCount = 1;
+    uniform_bindings[idx].descriptorType =
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    uniform_bindings[idx].pImmutableSamplers = nullptr;
+    uniform_bindings[idx].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    ++idx;
+  }
   for (uint32_t i = 0; i < n_uniform_texture_; ++i) {
     uniform_bindings[idx].binding = idx;
     uniform_bindings[idx].descriptorCount = 1;
@@ -220,31 +712,38 @@ VkResult RenderScene::InitDescriptor(Device* device) {
     ++idx;
   }
 
-  VkDescriptorSetLayoutCreateInfo layout_info{};
-  layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-  layout_info.bindingCount = uniform_bindings.size();
-  layout_info.pBindings = uniform_bindings.data();
-  result = vkCreateDescriptorSetLayout(device->device_, &layout_info, nullptr,
-                                       &layout_);
-  if (result != VK_SUCCESS) {
-    spdlog::error("desciptor set layout creation failed");
-    return result;
+  // the pipeline layout is built from it, keep it across model changes
+  if (layout_ == VK_NULL_HANDLE) {
+    VkDescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = uniform_bindings.size();
+    layout_info.pBindings = uniform_bindings.data();
+    result = vkCreateDescriptorSetLayout(device->device_, &layout_info,
+                                         nullptr, &layout_);
+    if (result != VK_SUCCESS) {
+      spdlog::error("desciptor set layout creation failed");
+      return result;
+    }
   }
 
   std::vector<VkDescriptorPoolSize> pool_sizes;
   pool_sizes.clear();
   if (n_uniform_buffer_ > 0) {
     VkDescriptorPoolSize pool_size;
-    pool_size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    pool_size.descriptorCount =
-        n_uniform_buffer_ * n_swap_image_ * models_.size();
+    pool_size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    pool_size.descriptorCount = n_uniform_buffer_;
+    pool_sizes.push_back(pool_size);
+  }
+  if (n_storage_buffer_ > 0) {
+    VkDescriptorPoolSize pool_size;
+    pool_size.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    pool_size.descriptorCount = n_storage_buffer_;
     pool_sizes.push_back(pool_size);
   }
   if (n_uniform_texture_ > 0) {
     VkDescriptorPoolSize pool_size;
     pool_size.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    pool_size.descriptorCount =
-        n_uniform_texture_ * n_swap_image_ * models_.size();
+    pool_size.descriptorCount = n_uniform_texture_;
     pool_sizes.push_back(pool_size);
   }
 
@@ -253,90 +752,137 @@ VkResult RenderScene::InitDescriptor(Device* device) {
   pool_info.pNext = nullptr;
   pool_info.poolSizeCount = (uint32_t)pool_sizes.size();
   pool_info.pPoolSizes = pool_sizes.data();
-  pool_info.maxSets = n_swap_image_ * models_.size();
-  pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+  pool_info.maxSets = 1;
+  pool_info.flags = 0;
   result = vkCreateDescriptorPool(device->device_, &pool_info, nullptr, &pool_);
   if (result != VK_SUCCESS) {
     spdlog::error("descriptor pool creation failed");
     return result;
   }
 
-  std::vector<VkDescriptorSetLayout> layouts(n_swap_image_ * models_.size(),
-                                             layout_);
   VkDescriptorSetAllocateInfo alloc_info{};
   alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
   alloc_info.descriptorPool = pool_;
-  alloc_info.descriptorSetCount = layouts.size();
-  alloc_info.pSetLayouts = layouts.data();
-  sets_.resize(layouts.size());
-  result = vkAllocateDescriptorSets(device->device_, &alloc_info, sets_.data());
+  alloc_info.descriptorSetCount = 1;
+  alloc_info.pSetLayouts = &layout_;
+  result = vkAllocateDescriptorSets(device->device_, &alloc_info, &set_);
   if (result != VK_SUCCESS) {
     spdlog::error("descriptor sets allocation failed");
     return result;
   }
 
-  for (size_t i = 0; i < n_swap_image_; ++i) {
-    for (size_t j = 0; j < models_.size(); ++j) {
-      VkDescriptorBufferInfo global_info{};
-      global_info.buffer = global_ubs_[i].buffer_;
-      global_info.offset = 0;
-      global_info.range = sizeof(GlobalUniformData);
-
-      VkWriteDescriptorSet global_write{};
-      global_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-      global_write.dstSet = sets_[i * models_.size() + j];
-      global_write.dstBinding = 0;
-      global_write.dstArrayElement = 0;
-      global_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-      global_write.descriptorCount = 1;
-      global_write.pBufferInfo = &global_info;
-
-      VkDescriptorBufferInfo model_info{};
-      model_info.buffer = model_ubs_[i].buffer_;
-      model_info.offset = models_[j].ubo_offset_;
-      model_info.range = models_[j].ubo_size_;
-
-      VkWriteDescriptorSet model_write{};
-      model_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-      model_write.dstSet = sets_[i * models_.size() + j];
-      model_write.dstBinding = 1;
-      model_write.dstArrayElement = 0;
-      model_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-      model_write.descriptorCount = 1;
-      model_write.pBufferInfo = &model_info;
-
-      std::array<VkWriteDescriptorSet, 2> writes{global_write, model_write};
-      vkUpdateDescriptorSets(device->device_, writes.size(), writes.data(), 0,
-                             nullptr);
+  return VK_SUCCESS;
+}
+
+void RenderScene::UpdateDescriptor(Device* device) {
+  // both bindings view the ring, BindDescriptor picks the frame region
+  VkDescriptorBufferInfo global_info{};
+  global_info.buffer = uniform_ring_.buffer_.buffer_;
+  global_info.offset = 0;
+  global_info.range = sizeof(GlobalUniformData);
+
+  VkWriteDescriptorSet global_write{};
+  global_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  global_write.dstSet = set_;
+  global_write.dstBinding = 0;
+  global_write.dstArrayElement = 0;
+  global_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  global_write.descriptorCount = 1;
+  global_write.pBufferInfo = &global_info;
+
+  VkDescriptorBufferInfo instance_info{};
+  instance_info.buffer = uniform_ring_.buffer_.buffer_;
+  instance_info.offset = 0;
+  instance_info.range = instance_capacity_ * sizeof(InstanceData);
+
+  VkWriteDescriptorSet instance_write{};
+  instance_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  instance_write.dstSet = set_;
+  instance_write.dstBinding = 1;
+  instance_write.dstArrayElement = 0;
+  instance_write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  instance_write.descriptorCount = 1;
+  instance_write.pBufferInfo = &instance_info;
+
+  VkDescriptorBufferInfo material_info{};
+  material_info.buffer = uniform_ring_.buffer_.buffer_;
+  material_info.offset = 0;
+  material_info.range = material_capacity_ * sizeof(MaterialData);
+
+  VkWriteDescriptorSet material_write{};
+  material_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  material_write.dstSet = set_;
+  material_write.dstBinding = 2;
+  material_write.dstArrayElement = 0;
+  material_write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  material_write.descriptorCount = 1;
+  material_write.pBufferInfo = &material_info;
+
+  VkDescriptorBufferInfo slot_info{};
+  slot_info.buffer = uniform_ring_.buffer_.buffer_;
+  slot_info.offset = 0;
+  slot_info.range = material_capacity_ * sizeof(uint32_t);
+
+  VkWriteDescriptorSet slot_write{};
+  slot_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  slot_write.dstSet = set_;
+  slot_write.dstBinding = 3;
+  slot_write.dstArrayElement = 0;
+  slot_write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  slot_write.descriptorCount = 1;
+  slot_write.pBufferInfo = &slot_info;
+
+  std::array<VkWriteDescriptorSet, 4> writes{global_write, instance_write,
+                                             material_write, slot_write};
+  vkUpdateDescriptorSets(device->device_, writes.size(), writes.data(), 0,
+                         nullptr);
+
+  // the culling sets are not dynamic, one per frame region
+  for (uint32_t frame = 0; frame < n_frame_; ++frame) {
+    VkDescriptorBufferInfo buffers[GpuCuller::BINDING_PYRAMID];
+    const VkDeviceSize areas[GpuCuller::BINDING_PYRAMID][2] = {
+        {cull_offset_, sizeof(CullUniformData)},
+        {global_size_, instance_capacity_ * sizeof(InstanceData)},
+        {state_offset_,
+         sizeof(CullState) + range_capacity_ * sizeof(RangeData)},
+        {template_offset_, command_capacity_ * sizeof(DrawTemplate)},
+        {slot_offset_, material_capacity_ * sizeof(uint32_t)},
+        {command_offset_,
+         command_capacity_ * sizeof(VkDrawIndexedIndirectCommand)},
+    };
+    for (uint32_t i = 0; i < GpuCuller::BINDING_PYRAMID; ++i) {
+      buffers[i].buffer = uniform_ring_.buffer_.buffer_;
+      buffers[i].offset = uniform_ring_.GetOffset(frame, areas[i][0]);
+      buffers[i].range = areas[i][1];
     }
+    culler_.UpdateDescriptor(device->device_, frame, buffers);
   }
-
-  return VK_SUCCESS;
 }
 
 void RenderScene::DestroyUniform(VkDevice device) {
-  if (layout_ != VK_NULL_HANDLE) {
-    vkDestroyDescriptorSetLayout(device, layout_, nullptr);
-    layout_ = VK_NULL_HANDLE;
-  }
   if (pool_ != VK_NULL_HANDLE) {
     vkDestroyDescriptorPool(device, pool_, nullptr);
     pool_ = VK_NULL_HANDLE;
+    set_ = VK_NULL_HANDLE;
   }
-  for (auto buffer : global_ubs_) {
-    buffer.Destroy(device);
-  }
-  for (auto buffer : model_ubs_) {
-    buffer.Destroy(device);
+  if (layout_ != VK_NULL_HANDLE) {
+    vkDestroyDescriptorSetLayout(device, layout_, nullptr);
+    layout_ = VK_NULL_HANDLE;
   }
+  uniform_ring_.Destroy(device);
 }
 
 void RenderScene::Destroy(VkDevice device) {
+  culler_.Destroy(device);
   DestroyUniform(device);
-  for (auto model : models_) {
-    model.Destroy(device);
+  for (auto& pool : vertex_pools_) {
+    pool.Destroy(device);
+  }
+  for (auto& pool : index_pools_) {
+    pool.Destroy(device);
   }
+  meshes_.clear();
+  mesh_ids_.clear();
   delete camera_;
-  delete model_ubo_data_;
 }
 };  // namespace Rain
\ No newline at end of file
@@ -2,12 +2,17 @@
 
 #include <vulkan/vulkan.h>
 
+#include <unordered_map>
 #include <vector>
 
 #include "buffer/buffer.h"
+#include "buffer/geometrypool.h"
+#include "buffer/uniformring.h"
 #include "camera/camera.h"
+#include "culling/gpuculler.h"
 #include "device/device.h"
 #include "mathtype.h"
+#include "scene/culling.h"
 #include "scene/scene.h"
 #include "surface/swapchain.h"
 #include "tetmesh.h"
@@ -20,36 +25,160 @@ struct GlobalUniformData {
   alignas(16) Vec3f light_direction;
 };
 
-struct ModelUniformData {
+// elements of the instance and material storage buffers, std430 keeps the
+// arrays tightly packed
+struct InstanceData {
+  // model transformation
+  alignas(16) Mat4f model_ = Mat4f::Identity();
+  // box of the quantized positions of VERTEX_FORMAT_COMPACT
+  alignas(16) Vec4f bbox_min_ = Vec4f::Zero();
+  alignas(16) Vec4f bbox_extent_ = Vec4f::Ones();
+  // for the GPU culling: the draw ranges of the mesh in the RangeData array
+  // and the material slot of the first one, the next ones are stride_ apart
+  alignas(16) uint32_t first_range_ = 0;
+  uint32_t n_range_ = 0;
+  uint32_t first_material_ = 0;
+  uint32_t stride_ = 0;
+};
+
+// one per draw range of an instance, the draws of a range read the slots
+// of their visible instances through the instance index
+struct MaterialData {
   // ambient + non-transparency
   alignas(16) Vec4f Ka_d_ = Vec4f(0.2f, 0.2f, 0.2f, 1.0f);
   // diffuse
   alignas(16) Vec4f Kd_ = Vec4f(0.8f, 0.8f, 0.8f, 0.0f);
   // specular rgb + shininess
   alignas(16) Vec4f Ks_Ns_ = Vec4f(1.0f, 1.0f, 1.0f, 0.0f);
-  // model transformation
-  alignas(16) Mat4f model_ = Mat4f::Identity();
+  // instance slot of the model
+  alignas(16) uint32_t instance_ = 0;
+};
+
+enum VertexFormat {
+  VERTEX_FORMAT_FLOAT = 0,  // 32-bit float positions and normals
+  // 16-bit unorm positions within the bounding box and octahedral normals
+  VERTEX_FORMAT_COMPACT,
+  VERTEX_FORMAT_NUM,
+};
+
+// vertex formats times index types
+const uint32_t MAX_DRAW_BATCH = VERTEX_FORMAT_NUM * 2;
+// direct draws below which a piece of a batch is not worth a secondary
+// command buffer of its own
+const uint32_t MIN_CHUNK_DRAWS = 256;
+
+// consecutive indirect commands drawn with the same pipeline and pools
+struct DrawBatch {
+  VertexFormat vertex_format_;
+  VkIndexType index_type_;
+  uint32_t first_command_;
+  uint32_t n_command_;
+  uint32_t count_;  // in CullState::draw_counts_, GPU culling only
+};
+
+// The GPU culling data of a frame region, as in cull.comp
+struct CullUniformData {
+  // Culling::ExtractPlanes of the camera
+  alignas(16) Vec4f planes_[6];
+  // camera of the depth in the pyramid
+  alignas(16) Mat4f pyramid_proj_view_;
+  // depth buffer width and height, pyramid levels, 1 to test against it
+  alignas(16) Vec4f pyramid_size_;
+  alignas(16) uint32_t n_instance_;
+  uint32_t n_template_;
+  uint32_t frustum_;  // 1 to test against the planes
+};
+
+// visible instances of a draw range of a mesh, written from first_slot_ in
+// the draw slots
+struct RangeData {
+  uint32_t first_slot_;
+  uint32_t count_;
 };
 
+// counters of the culling pass, followed by the RangeData array
+struct CullState {
+  uint32_t draw_counts_[MAX_DRAW_BATCH];
+  uint32_t n_tested_;
+  uint32_t n_frustum_;   // culled against the planes
+  uint32_t n_occluded_;  // culled against the depth pyramid
+  uint32_t pad_;
+};
+
+// a sub-mesh command whose instance count and first instance come from its
+// RangeData
+struct DrawTemplate {
+  uint32_t index_count_;
+  uint32_t first_index_;
+  int32_t vertex_offset_;
+  uint32_t range_;
+  uint32_t batch_;          // DrawBatch::count_
+  uint32_t first_command_;  // of the batch
+};
+
+// slot in RenderScene::index_pools_ of the indices of the given type
+inline uint32_t IndexPoolOf(VkIndexType index_type) {
+  return index_type == VK_INDEX_TYPE_UINT16 ? 0 : 1;
+}
+
+// part of a draw range, first_index_ and vertex_offset_ point into the
+// geometry pools and the indices are relative to vertex_offset_
+struct SubMesh {
+  uint32_t first_index_;
+  uint32_t n_index_;
+  int32_t vertex_offset_;
+  uint32_t range_;
+};
+
+// vertex and index ranges of one MeshAsset in the geometry pools of the
+// scene, shared by its instances which are drawn together
+class RenderMesh {
+ public:
+  MeshHandle mesh_;
+  std::vector<uint32_t> instances_;  // resident models, in RenderScene::models_
+  uint32_t first_instance_ = 0;  // instance slot of instances_[0]
+  // material slot of instances_[0] for the first draw range, the slots of a
+  // draw range are adjacent so that one instanced draw covers them
+  uint32_t first_material_ = 0;
+  uint32_t first_range_ = 0;  // in the RangeData array
+  VkIndexType index_type_ = VK_INDEX_TYPE_UINT32;
+  VertexFormat vertex_format_ = VERTEX_FORMAT_FLOAT;
+  uint64_t first_vertex_ = 0;  // in the vertex pool of vertex_format_
+  uint64_t first_index_ = 0;   // in the index pool of index_type_
+  uint32_t vertex_node_ = RangeAllocator::NULL_NODE;
+  uint32_t index_node_ = RangeAllocator::NULL_NODE;
+  std::vector<SubMesh> submeshes_;
+
+  void Init(const MeshHandle& mesh, VertexFormat vertex_format);
+  // 16-bit indices when every draw range splits into sub-meshes spanning
+  // less than 64K vertices, 32-bit ones otherwise
+  void BuildSubMeshes(std::vector<uint16_t>& indices16);
+  // upload into the pool of vertex_format_ and the index pool of the
+  // index type picked by BuildSubMeshes
+  VkResult CreateBuffers(Device* device, GeometryPool& vertex_pool,
+                         GeometryPool* index_pools);
+  // give the ranges back to the pools CreateBuffers took them from
+  void FreeBuffers(GeometryPool& vertex_pool, GeometryPool* index_pools);
+  static std::vector<VkVertexInputBindingDescription> GetBindDescription(
+      VertexFormat vertex_format);
+  static std::vector<VkVertexInputAttributeDescription>
+  GetAttributeDescriptions(VertexFormat vertex_format);
+};
+
+// one Object, an instance of its RenderMesh
 class RenderModel {
-  // TODO: not optimal, use vma to alloc a big buffer, then divide to models
  public:
   Object* obj_;
-  ModelUniformData uniform_data_;
-  std::vector<Buffer> vertex_buffers_;
-  Buffer index_buffer_;
-  std::vector<VkBuffer> vertex_vkbuffers_;
-  std::vector<VkDeviceSize> vertex_vkbuffer_offsets_;
+  uint32_t mesh_;  // in RenderScene::meshes_
+  uint32_t instance_;  // in RenderMesh::instances_
+  InstanceData instance_data_;
+  std::vector<MaterialData> material_data_;  // per draw range
 
-  uint32_t ubo_offset_;
-  uint32_t ubo_size_;
+  // frames whose ring region does not hold the data above yet
+  uint32_t dirty_frames_ = 0;
+  bool resident_ = false;  // mesh uploaded, ready to draw
 
-  void Init(Object* obj);
-  VkResult CreateBuffers(Device* device);
-  void Destroy(VkDevice device);
-  static std::vector<VkVertexInputBindingDescription> GetBindDescription();
-  static std::vector<VkVertexInputAttributeDescription>
-  GetAttributeDescriptions();
+  void Init(Object* obj, uint32_t mesh);
 };
 
 class RenderScene {
@@ -60,26 +189,116 @@ class RenderScene {
   Vec3f light_direction_;
   float light_x_angle_ = 45.0;
   float light_y_angle_ = 45.0;
+  // format of the meshes uploaded from now on
+  VertexFormat vertex_format_ = VERTEX_FORMAT_COMPACT;
 
-  std::vector<Buffer> global_ubs_;  // per swap image
-  std::vector<Buffer> model_ubs_; // per swap image
+  // per frame in flight: the global data, one instance slot per resident
+  // model, one material slot per draw range of it, the material slots of the
+  // drawn instances, the indirect commands and the GPU culling data
+  UniformRing uniform_ring_;
+  uint32_t global_size_;  // aligned for the instance slots after it
+  VkDeviceSize material_offset_ = 0;  // in a frame region
+  VkDeviceSize slot_offset_ = 0;
+  VkDeviceSize command_offset_ = 0;
+  VkDeviceSize cull_offset_ = 0;
+  VkDeviceSize state_offset_ = 0;
+  VkDeviceSize template_offset_ = 0;
+  uint32_t instance_capacity_ = 0;
+  uint32_t material_capacity_ = 0;
+  uint32_t command_capacity_ = 0;
+  uint32_t range_capacity_ = 0;
+  // rebuilt every frame, also the source of the direct draws when the
+  // device can not draw them indirectly
+  std::vector<VkDrawIndexedIndirectCommand> commands_;
+  std::vector<DrawBatch> batches_;
+  std::vector<uint32_t> draw_slots_;
+  // world bounds of the models, in models_ order
+  BoundsTable bounds_;
+  bool culling_ = true;  // frustum culling against the camera
+  CullStats cull_stats_;
+  std::vector<uint32_t> visible_;  // models passing the culling
+  // visible instances of meshes_[m] from visible_offsets_[m], in
+  // RenderMesh::instances_
+  std::vector<uint32_t> visible_offsets_;
+  std::vector<uint32_t> visible_instances_;
+  // multiDrawIndirect and drawIndirectFirstInstance
+  bool multi_draw_indirect_ = false;
+  // changes whenever command buffers recorded with Draw would: the ring
+  // layout and the resident meshes, the culling path, the batches and the
+  // arguments of the direct draws. Transforms and materials are read from
+  // the ring and keep it
+  uint64_t draw_version_ = 0;
+  std::vector<DrawBatch> drawn_batches_;
+  std::vector<VkDrawIndexedIndirectCommand> drawn_commands_;
+  bool drawn_gpu_culling_ = false;
+  // the commands and draw slots written by compute shaders instead, from
+  // templates_ and ranges_ rebuilt every frame
+  GpuCuller culler_;
+  bool gpu_culling_ = false;
+  bool occlusion_culling_ = true;  // GPU culling only
+  std::vector<DrawTemplate> templates_;
+  std::vector<RangeData> ranges_;
+  uint32_t culled_frames_ = 0;  // regions whose CullState the GPU wrote
+  PFN_vkCmdDrawIndexedIndirectCountKHR draw_indexed_indirect_count_ = nullptr;
+  // geometry of every resident mesh, bound once per vertex format and index
+  // type instead of once per model
+  GeometryPool vertex_pools_[VERTEX_FORMAT_NUM];
+  GeometryPool index_pools_[2];  // 16-bit, 32-bit
+  std::vector<RenderMesh> meshes_;
+  std::unordered_map<const MeshAsset*, uint32_t> mesh_ids_;
   std::vector<RenderModel> models_;
-  uint32_t n_swap_image_;
-  uint8_t* model_ubo_data_ = nullptr;
-  uint32_t model_ubo_size_;
-  uint32_t n_uniform_buffer_ = 2;  // TODO: now only global
+  Scene* scene_ = nullptr;
+  uint32_t n_frame_;  // frames in flight
+  uint32_t n_instance_ = 0;  // resident models
+  uint32_t n_material_ = 0;  // draw ranges of the resident models
+  uint32_t n_command_ = 0;   // sub-meshes of the resident meshes
+  uint32_t n_range_ = 0;     // draw ranges of the resident meshes
+  uint32_t n_uniform_buffer_ = 1;   // global
+  uint32_t n_storage_buffer_ = 3;   // instance, material and draw slots
   uint32_t n_uniform_texture_ = 0;
 
   VkDescriptorSetLayout layout_ = VK_NULL_HANDLE;
   VkDescriptorPool pool_ = VK_NULL_HANDLE;
-  std::vector<VkDescriptorSet> sets_;
+  // one set for every draw whatever the scene size, the frame region comes
+  // from dynamic offsets and the slots from the instance index
+  VkDescriptorSet set_ = VK_NULL_HANDLE;
 
   VkResult Init(Device* device, SwapChain* swap_chain, Scene* scene);
   VkResult InitUniform(Device* device, SwapChain* swap_chain);
+  // slots for every instance and draw range of the resident models
+  VkResult InitModelUniform(Device* device);
   VkResult InitDescriptor(Device* device);
-  void UpdateUniform(VkDevice device, uint32_t image_index);
-  void BindAndDraw(VkCommandBuffer command_buffer, VkPipelineLayout layout,
-                   uint32_t image_index, uint32_t model_index);
+  void UpdateDescriptor(Device* device);
+  // uploads the objects whose loads finished since the last call
+  VkResult UpdateResidency(Device* device);
+  // refresh the uniforms of a model after its Object changed
+  void UpdateModel(size_t model_index);
+  // write the global data, the dirty models and the draws into the ring
+  // region of frame
+  void UpdateUniform(VkDevice device, uint32_t frame);
+  // culls the models and builds commands_ and batches_ of the visible
+  // ones, sorted by vertex format and index type
+  void BuildDraws(uint32_t frame);
+  // the templates and ranges of every resident mesh for the GPU culling
+  void BuildTemplates(uint32_t frame);
+  // bumps draw_version_ when the draws just built differ from the last ones
+  void UpdateDrawVersion();
+  // GPU culling of frame before the render pass, and the depth pyramid for
+  // the next frame after it; nothing without GPU culling
+  void RecordCulling(VkCommandBuffer command_buffer, uint32_t frame);
+  void RecordDepthPyramid(VkCommandBuffer command_buffer,
+                          uint32_t image_index);
+  // batches_ cut into about max_chunk pieces recorded in parallel, an
+  // indirect batch is one call and stays whole
+  void SplitDraws(uint32_t max_chunk, std::vector<DrawBatch>& chunks) const;
+  // once per frame, the set does not change between draws
+  void BindDescriptor(VkCommandBuffer command_buffer, VkPipelineLayout layout,
+                      uint32_t frame);
+  // one indirect draw for the whole batch, or a loop when not supported;
+  // the pools are bound by the caller. The GPU culled commands are drawn up
+  // to the draw count of the batch when there is one
+  void Draw(VkCommandBuffer command_buffer, uint32_t frame,
+            const DrawBatch& batch);
   void DestroyUniform(VkDevice device);
   void Destroy(VkDevice device);
 };
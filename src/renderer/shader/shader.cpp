@@ -29,12 +29,13 @@ VkResult Shader::Init(VkDevice device, const std::string& name) {
 
   for (size_t i = 0; i < SHADER_STAGE_NUM; ++i) {
     std::string file_name = "shaders/" + name + "_" + file_ext[i] + ".spv";
-    std::vector<char> code = IO::ReadFile(file_name);
-    if (code.size()) {
+    // most stages do not exist, that is a single failed open
+    IO::MappedFile code;
+    if (code.Open(file_name)) {
       VkShaderModuleCreateInfo create_info{};
       create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-      create_info.codeSize = code.size();
-      create_info.pCode = reinterpret_cast<const uint32_t*>(code.data());
+      create_info.codeSize = code.size_;
+      create_info.pCode = reinterpret_cast<const uint32_t*>(code.data_);
       VkResult result =
           vkCreateShaderModule(device, &create_info, nullptr, &modules_[i]);
       if (result != VK_SUCCESS) {
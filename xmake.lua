@@ -8,5 +8,61 @@ target("RainEngine")
     set_kind("binary")
     add_includedirs("src/engine", "src/common", "src/geometry", "src/physics", "src/renderer", "ext/imgui")
     add_files("src/main.cpp", "src/*/*.cpp", "src/*/*/*.cpp", "ext/imgui/*.cpp", "ext/imgui/backends/*.cpp")
-    add_packages("glfw", "spdlog", "eigen", "cmake::Vulkan", "tinyobjloader", {public=true})
+    add_packages("glfw", "spdlog", "eigen", "cmake::Vulkan", {public=true})
+    set_targetdir("bin")
+
+target("objload_bench")
+    set_kind("binary")
+    set_default(false)
+    add_includedirs("src/common", "src/geometry")
+    add_files("bench/objload_bench.cpp", "src/common/helper/*.cpp", "src/common/scene/*.cpp", "src/geometry/*.cpp")
+    add_packages("spdlog", "eigen", "tinyobjloader")
+    set_targetdir("bin")
+
+target("weld_bench")
+    set_kind("binary")
+    set_default(false)
+    add_includedirs("src/common", "src/geometry")
+    add_files("bench/weld_bench.cpp", "src/common/helper/*.cpp", "src/common/scene/*.cpp", "src/geometry/*.cpp")
+    add_packages("spdlog", "eigen")
+    set_targetdir("bin")
+
+target("normals_bench")
+    set_kind("binary")
+    set_default(false)
+    add_includedirs("src/common", "src/geometry")
+    add_files("bench/normals_bench.cpp", "src/common/helper/*.cpp", "src/common/scene/*.cpp", "src/geometry/*.cpp")
+    add_packages("spdlog", "eigen")
+    set_targetdir("bin")
+
+target("scene_bench")
+    set_kind("binary")
+    set_default(false)
+    add_includedirs("src/common", "src/geometry")
+    add_files("bench/scene_bench.cpp", "src/common/helper/*.cpp", "src/common/scene/*.cpp", "src/geometry/*.cpp")
+    add_packages("spdlog", "eigen")
+    set_targetdir("bin")
+
+target("upload_bench")
+    set_kind("binary")
+    set_default(false)
+    add_includedirs("src/common", "src/renderer")
+    add_files("bench/upload_bench.cpp", "src/common/helper/*.cpp", "src/renderer/device/device.cpp", "src/renderer/buffer/buffer.cpp", "src/renderer/memory/*.cpp")
+    add_packages("glfw", "spdlog", "eigen", "cmake::Vulkan")
+    set_targetdir("bin")
+
+target("cull_bench")
+    set_kind("binary")
+    set_default(false)
+    add_includedirs("src/common")
+    add_files("bench/cull_bench.cpp", "src/common/scene/culling.cpp")
+    add_packages("spdlog", "eigen")
+    set_targetdir("bin")
+
+target("gpu_cull_check")
+    set_kind("binary")
+    set_default(false)
+    add_includedirs("src/engine", "src/common", "src/geometry", "src/physics", "src/renderer")
+    add_files("bench/gpu_cull_check.cpp", "src/common/helper/*.cpp", "src/common/scene/culling.cpp", "src/renderer/device/device.cpp", "src/renderer/buffer/buffer.cpp", "src/renderer/buffer/uniformring.cpp", "src/renderer/image/image.cpp", "src/renderer/shader/shader.cpp", "src/renderer/culling/gpuculler.cpp", "src/renderer/memory/*.cpp")
+    add_packages("glfw", "spdlog", "eigen", "cmake::Vulkan")
     set_targetdir("bin")
\ No newline at end of file